@@ -0,0 +1,108 @@
+#include <aligned_pmr_vector.hpp>
+#include <aligned_resource.hpp>
+#include <benchmark.hpp>
+#include <memory_resource.hpp>
+#include <vector.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <numeric>
+
+// Keep a numeric batch in an arena, aligned and padded to 64 bytes, and
+// compare its bulk operations with the standard algorithms over a plain
+// 'std::pmr::vector<float>' in the same arena.
+
+namespace {
+
+// An odd size, so that the plain vector has a tail to peel.
+constexpr std::size_t elementCount = 1000003;
+constexpr int repetitions = 100;
+
+} // namespace
+
+int main() {
+  counting_resource upstream;
+  std::pmr::monotonic_buffer_resource arena(&upstream);
+  aligned_resource aligned(64, &arena);
+
+  std::pmr::vector<float> plain(elementCount, 1.0f, &arena);
+  // Grow the batch one element at a time, so that every reallocation has to
+  // carry the elements before it along.
+  aligned_pmr_vector<float, 64> batch(&aligned);
+  for (std::size_t i = 0; i != elementCount; ++i)
+    batch.push_back(1.0f);
+  assert(batch.size() == elementCount);
+  assert(batch.sum() == static_cast<float>(elementCount));
+
+  // The element-wise operations must leave the padding of a partial last
+  // block alone: dividing by the divisors' padding would trap.
+  {
+    aligned_pmr_vector<int> dividends{10, 20, 30}, divisors{1, 2, 3};
+    int calls = 0;
+    dividends.transform(divisors, std::divides<int>());
+    dividends.transform([&](int x) { return ++calls, x; });
+    assert(dividends[0] == 10 && dividends[1] == 10 && dividends[2] == 10);
+    assert(calls == 3);
+  }
+
+  std::cout << "## plain data % 64 = "
+            << reinterpret_cast<std::uintptr_t>(plain.data()) % 64
+            << std::endl;
+  std::cout << "## aligned data % 64 = "
+            << reinterpret_cast<std::uintptr_t>(batch.data()) % 64
+            << ", padded size = " << batch.padded_size() << std::endl;
+  std::cout << std::endl;
+
+  const std::size_t operations = elementCount * repetitions;
+  benchmark_table table;
+  table.header();
+
+  table.run("plain fill", operations, upstream, [&] {
+    for (int r = 0; r != repetitions; ++r) {
+      std::fill(plain.begin(), plain.end(), static_cast<float>(r));
+      do_not_optimize(plain.data());
+    }
+  });
+  table.run("aligned fill", operations, upstream, [&] {
+    for (int r = 0; r != repetitions; ++r) {
+      batch.fill(static_cast<float>(r));
+      do_not_optimize(batch.data());
+    }
+  });
+
+  table.run("plain transform", operations, upstream, [&] {
+    for (int r = 0; r != repetitions; ++r) {
+      std::transform(plain.begin(), plain.end(), plain.begin(),
+                     [](float x) { return x * 0.5f + 1.0f; });
+      do_not_optimize(plain.data());
+    }
+  });
+  table.run("aligned transform", operations, upstream, [&] {
+    for (int r = 0; r != repetitions; ++r) {
+      batch.transform([](float x) { return x * 0.5f + 1.0f; });
+      do_not_optimize(batch.data());
+    }
+  });
+
+  float plainSum = 0;
+  table.run("plain reduce", operations, upstream, [&] {
+    for (int r = 0; r != repetitions; ++r) {
+      plainSum = std::reduce(plain.begin(), plain.end(), 0.0f);
+      do_not_optimize(plainSum);
+    }
+  });
+  float alignedSum = 0;
+  table.run("aligned reduce", operations, upstream, [&] {
+    for (int r = 0; r != repetitions; ++r) {
+      alignedSum = batch.sum();
+      do_not_optimize(alignedSum);
+    }
+  });
+
+  std::cout << "\n## sums: plain " << plainSum << ", aligned " << alignedSum
+            << std::endl;
+}
@@ -0,0 +1,267 @@
+#ifndef ALIGNED_PMR_VECTOR_HPP_
+#define ALIGNED_PMR_VECTOR_HPP_
+
+// A vector of numbers whose storage is aligned to 'Align' bytes and padded
+// to a whole number of 'Align'-byte blocks. Its bulk operations work block
+// by block over the padded storage, masking the lanes of the last block
+// that are past 'size()', so the compiler can vectorize them without
+// peeling a prologue for alignment or an epilogue for the tail.
+//
+// Storage comes from the allocator's resource with an alignment request of
+// 'Align'. Resources that ignore alignment, like the BDE-backed
+// 'monotonic_buffer_resource', should be wrapped in an 'aligned_resource'.
+
+#include <memory_resource.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <stdexcept>
+#include <type_traits>
+
+template <typename T, std::size_t Align = 64> class aligned_pmr_vector {
+  static_assert(std::is_arithmetic_v<T>, "elements must be numbers");
+  static_assert(Align % sizeof(T) == 0 && (Align & (Align - 1)) == 0,
+                "alignment must be a power of two holding whole elements");
+
+public:
+  using value_type = T;
+  using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+  using size_type = std::size_t;
+  using iterator = T *;
+  using const_iterator = const T *;
+
+  // The number of elements in one aligned block.
+  static constexpr size_type lanes = Align / sizeof(T);
+
+  aligned_pmr_vector(allocator_type allocator = {}) : d_allocator(allocator) {}
+
+  aligned_pmr_vector(size_type count, T value = T(),
+                     allocator_type allocator = {})
+      : aligned_pmr_vector(allocator) {
+    resize(count, value);
+  }
+
+  aligned_pmr_vector(std::initializer_list<T> values,
+                     allocator_type allocator = {})
+      : aligned_pmr_vector(allocator) {
+    reserve(values.size());
+    std::copy(values.begin(), values.end(), d_data);
+    d_size = values.size();
+  }
+
+  aligned_pmr_vector(const aligned_pmr_vector &other,
+                     allocator_type allocator = {})
+      : aligned_pmr_vector(allocator) {
+    reserve(other.d_size);
+    std::memcpy(d_data, other.d_data, other.d_size * sizeof(T));
+    d_size = other.d_size;
+  }
+
+  aligned_pmr_vector(aligned_pmr_vector &&other) noexcept
+      : d_allocator(other.d_allocator) {
+    steal(other);
+  }
+
+  aligned_pmr_vector(aligned_pmr_vector &&other, allocator_type allocator)
+      : d_allocator(allocator) {
+    if (d_allocator == other.d_allocator)
+      steal(other);
+    else {
+      reserve(other.d_size);
+      std::memcpy(d_data, other.d_data, other.d_size * sizeof(T));
+      d_size = other.d_size;
+    }
+  }
+
+  ~aligned_pmr_vector() { deallocate(); }
+
+  aligned_pmr_vector &operator=(const aligned_pmr_vector &other) {
+    if (this != &other) {
+      d_size = 0;
+      reserve(other.d_size);
+      std::memcpy(d_data, other.d_data, other.d_size * sizeof(T));
+      d_size = other.d_size;
+    }
+    return *this;
+  }
+
+  aligned_pmr_vector &operator=(aligned_pmr_vector &&other) {
+    if (this == &other)
+      return *this;
+    if (d_allocator == other.d_allocator) {
+      deallocate();
+      steal(other);
+    } else
+      *this = static_cast<const aligned_pmr_vector &>(other);
+    return *this;
+  }
+
+  allocator_type get_allocator() const noexcept { return d_allocator; }
+
+  T *data() noexcept { return d_data; }
+  const T *data() const noexcept { return d_data; }
+  iterator begin() noexcept { return d_data; }
+  const_iterator begin() const noexcept { return d_data; }
+  iterator end() noexcept { return d_data + d_size; }
+  const_iterator end() const noexcept { return d_data + d_size; }
+
+  size_type size() const noexcept { return d_size; }
+  size_type capacity() const noexcept { return d_capacity; }
+  bool empty() const noexcept { return d_size == 0; }
+
+  // Return 'size()' rounded up to a whole number of blocks. The elements
+  // past 'size()' are padding with unspecified values.
+  size_type padded_size() const noexcept { return round_up(d_size); }
+
+  T &operator[](size_type i) { return d_data[i]; }
+  const T &operator[](size_type i) const { return d_data[i]; }
+
+  void reserve(size_type capacity) {
+    capacity = round_up(capacity);
+    if (capacity <= d_capacity)
+      return;
+    T *const storage = static_cast<T *>(d_allocator.resource()->allocate(
+        capacity * sizeof(T), Align));
+    assert(reinterpret_cast<std::uintptr_t>(storage) % Align == 0);
+    if (d_size)
+      std::memcpy(storage, d_data, d_size * sizeof(T));
+    // Keep the padding of a fresh block from holding signaling garbage.
+    std::fill(storage + d_size, storage + capacity, T());
+    const size_type size = d_size;
+    deallocate();
+    d_data = storage;
+    d_size = size;
+    d_capacity = capacity;
+  }
+
+  void resize(size_type count, T value = T()) {
+    reserve(count);
+    if (count > d_size)
+      std::fill(d_data + d_size, d_data + count, value);
+    d_size = count;
+  }
+
+  void push_back(T value) {
+    if (d_size == d_capacity)
+      reserve(std::max<size_type>(2 * d_capacity, lanes));
+    d_data[d_size++] = value;
+  }
+
+  void clear() noexcept { d_size = 0; }
+
+  // Set every element to 'value'.
+  void fill(T value) {
+    T *const p = aligned_data();
+    const size_type blocks = padded_size() / lanes;
+    for (size_type b = 0; b != blocks; ++b)
+      for (size_type j = 0; j != lanes; ++j)
+        p[b * lanes + j] = value;
+  }
+
+  // Replace every element 'x' with 'op(x)'. 'op' is called once per
+  // element and never on the padding.
+  template <typename UnaryOp> void transform(UnaryOp op) {
+    T *const p = aligned_data();
+    const size_type full = d_size / lanes;
+    const size_type rest = d_size % lanes;
+    for (size_type b = 0; b != full; ++b)
+      for (size_type j = 0; j != lanes; ++j)
+        p[b * lanes + j] = op(p[b * lanes + j]);
+    // The last, partial block is masked rather than peeled.
+    if (rest) {
+      T *const last = p + full * lanes;
+      for (size_type j = 0; j != lanes; ++j)
+        last[j] = j < rest ? op(last[j]) : last[j];
+    }
+  }
+
+  // Replace every element 'x' with 'op(x, y)', where 'y' is the element of
+  // 'other' at the same index. 'other' must be at least as long. 'op' is
+  // called once per element and never on the padding.
+  template <typename BinaryOp>
+  void transform(const aligned_pmr_vector &other, BinaryOp op) {
+    if (other.d_size < d_size)
+      throw std::length_error("aligned_pmr_vector::transform");
+    T *const p = aligned_data();
+    const T *const q = other.aligned_data();
+    const size_type full = d_size / lanes;
+    const size_type rest = d_size % lanes;
+    for (size_type b = 0; b != full; ++b)
+      for (size_type j = 0; j != lanes; ++j)
+        p[b * lanes + j] = op(p[b * lanes + j], q[b * lanes + j]);
+    if (rest) {
+      T *const last = p + full * lanes;
+      const T *const otherLast = q + full * lanes;
+      for (size_type j = 0; j != lanes; ++j)
+        last[j] = j < rest ? op(last[j], otherLast[j]) : last[j];
+    }
+  }
+
+  // Return the elements combined with the associative and commutative 'op',
+  // starting from its 'identity'. Elements are combined lane by lane, so
+  // the order differs from a sequential loop; for floating point this can
+  // change the rounding.
+  template <typename BinaryOp> T reduce(T identity, BinaryOp op) const {
+    const T *const p = aligned_data();
+    const size_type full = d_size / lanes;
+    const size_type rest = d_size % lanes;
+    T partial[lanes];
+    for (size_type j = 0; j != lanes; ++j)
+      partial[j] = identity;
+    for (size_type b = 0; b != full; ++b)
+      for (size_type j = 0; j != lanes; ++j)
+        partial[j] = op(partial[j], p[b * lanes + j]);
+    // The last, partial block is masked rather than peeled.
+    if (rest) {
+      const T *const last = p + full * lanes;
+      for (size_type j = 0; j != lanes; ++j)
+        partial[j] = j < rest ? op(partial[j], last[j]) : partial[j];
+    }
+    T result = identity;
+    for (size_type j = 0; j != lanes; ++j)
+      result = op(result, partial[j]);
+    return result;
+  }
+
+  T sum() const {
+    return reduce(T(), [](T a, T b) { return a + b; });
+  }
+
+private:
+  allocator_type d_allocator;
+  T *d_data = nullptr;
+  size_type d_size = 0;
+  size_type d_capacity = 0;
+
+  static size_type round_up(size_type count) {
+    return (count + lanes - 1) / lanes * lanes;
+  }
+
+  T *aligned_data() const {
+    return static_cast<T *>(__builtin_assume_aligned(d_data, Align));
+  }
+
+  void deallocate() noexcept {
+    if (d_data)
+      d_allocator.resource()->deallocate(d_data, d_capacity * sizeof(T),
+                                         Align);
+    d_data = nullptr;
+    d_size = 0;
+    d_capacity = 0;
+  }
+
+  void steal(aligned_pmr_vector &other) noexcept {
+    d_data = other.d_data;
+    d_size = other.d_size;
+    d_capacity = other.d_capacity;
+    other.d_data = nullptr;
+    other.d_size = 0;
+    other.d_capacity = 0;
+  }
+};
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef ALIGNED_RESOURCE_HPP_
+#define ALIGNED_RESOURCE_HPP_
+
+// A resource that guarantees every block it returns is aligned to at least
+// 'alignment' bytes (a cache line or an AVX-512 register, say) and padded to
+// a multiple of it, whatever the upstream resource does with its 'align'
+// argument. This makes it safe to put over resources that ignore alignment,
+// like the BDE-backed 'monotonic_buffer_resource' of 'memory_resource.hpp'.
+//
+// The guarantee costs up to 'alignment' plus a word of slack per block: the
+// offset back to the upstream block is stored just before the aligned one.
+
+#include <memory_resource.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+class aligned_resource : public std::pmr::memory_resource {
+public:
+  explicit aligned_resource(std::size_t alignment = 64,
+                            std::pmr::memory_resource *upstream =
+                                std::pmr::get_default_resource())
+      : d_upstream(upstream), d_alignment(alignment) {
+    assert(alignment && (alignment & (alignment - 1)) == 0);
+  }
+
+  std::size_t alignment() const { return d_alignment; }
+
+  // Return 'bytes' rounded up to a multiple of 'alignment()'.
+  std::size_t padded_size(std::size_t bytes) const {
+    return (bytes + d_alignment - 1) & ~(d_alignment - 1);
+  }
+
+  std::pmr::memory_resource *upstream_resource() const { return d_upstream; }
+
+private:
+  std::pmr::memory_resource *d_upstream;
+  std::size_t d_alignment;
+
+  std::size_t upstream_size(std::size_t bytes, std::size_t align) const {
+    const std::size_t padded = (bytes + align - 1) & ~(align - 1);
+    return padded + align + sizeof(std::size_t);
+  }
+
+  void *do_allocate(size_t bytes, size_t align) override {
+    align = std::max(align, d_alignment);
+    char *const raw = static_cast<char *>(
+        d_upstream->allocate(upstream_size(bytes, align), align));
+    const std::uintptr_t first =
+        reinterpret_cast<std::uintptr_t>(raw + sizeof(std::size_t));
+    char *const aligned =
+        reinterpret_cast<char *>((first + align - 1) & ~(align - 1));
+    const std::size_t offset = aligned - raw;
+    std::memcpy(aligned - sizeof offset, &offset, sizeof offset);
+    return aligned;
+  }
+
+  void do_deallocate(void *p, size_t bytes, size_t align) override {
+    align = std::max(align, d_alignment);
+    std::size_t offset;
+    std::memcpy(&offset, static_cast<char *>(p) - sizeof offset,
+                sizeof offset);
+    d_upstream->deallocate(static_cast<char *>(p) - offset,
+                           upstream_size(bytes, align), align);
+  }
+
+  bool do_is_equal(memory_resource const &other) const noexcept override {
+    return this == &other;
+  }
+};
+
+#endif
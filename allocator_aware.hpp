@@ -0,0 +1,232 @@
+#ifndef ALLOCATOR_AWARE_HPP_
+#define ALLOCATOR_AWARE_HPP_
+
+// Bases that write the allocator-aware boilerplate of 'simplicity.hpp' for a
+// class described by its list of members:
+//
+//     class Bar10 : public allocator_aware<Bar10, std::pmr::string> {
+//     public:
+//       using allocator_aware::allocator_aware;
+//       Bar10(allocator_type allocator = {})
+//           : allocator_aware(std::allocator_arg, allocator, "data") {}
+//     };
+//
+//     class Foo10 : public indirect_allocator_aware<Foo10, Bar10> {
+//     public:
+//       using indirect_allocator_aware::indirect_allocator_aware;
+//     };
+//
+// Both generate 'allocator_type', a 'get_allocator' borrowed from the first
+// member that uses an allocator (so no allocator is stored), the
+// allocator-extended copy and move constructors, a plain move constructor,
+// assignment, and the destructor. Each 'Members' element is constructed
+// with the uses-allocator protocol, so allocator-aware members receive the
+// object's allocator and the others are left alone. Derived classes reach
+// their members with 'member<I>()'.
+//
+// 'allocator_aware' stores the members inline; the allocator-extended move
+// constructor leaves it to each member to steal when the allocators are
+// equal. 'indirect_allocator_aware' stores them in one node allocated from
+// the object's allocator and holds only a pointer to it, like 'Foo9', so its
+// plain move constructor is 'noexcept' and the allocator-extended one
+// steals the node when the allocators are equal. A moved-from indirect
+// object holds no node; it may be destroyed or assigned to, and its
+// 'get_allocator' returns the default allocator.
+//
+// 'Derived' only makes each base a distinct type, so that a class can't be
+// copied from another that happens to have the same members.
+
+#include <memory_resource.hpp>
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace allocator_aware_detail {
+
+using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+// The index of the first of 'Members' that uses 'allocator_type'.
+template <typename... Members> constexpr std::size_t allocator_source() {
+  constexpr bool uses[] = {std::uses_allocator_v<Members, allocator_type>...};
+  for (std::size_t i = 0; i != sizeof...(Members); ++i)
+    if (uses[i])
+      return i;
+  return sizeof...(Members);
+}
+
+// Enable a constructor taking one argument per member of 'Tuple'.
+template <typename Tuple, typename... Args>
+using enable_if_member_args = std::enable_if_t<
+    sizeof...(Args) != 0 &&
+    std::is_constructible_v<Tuple, std::allocator_arg_t,
+                            const allocator_type &, Args &&...>>;
+
+} // namespace allocator_aware_detail
+
+template <typename Derived, typename... Members> class allocator_aware {
+  static constexpr std::size_t k_source =
+      allocator_aware_detail::allocator_source<Members...>();
+  static_assert(k_source != sizeof...(Members),
+                "a member must use an allocator to borrow it from");
+
+public:
+  using allocator_type = allocator_aware_detail::allocator_type;
+
+  allocator_aware(allocator_type allocator = {})
+      : d_members(std::allocator_arg, allocator) {}
+
+  // Construct each member from the corresponding element of 'args'.
+  template <typename... Args,
+            typename = allocator_aware_detail::enable_if_member_args<
+                std::tuple<Members...>, Args...>>
+  allocator_aware(std::allocator_arg_t, allocator_type allocator,
+                  Args &&... args)
+      : d_members(std::allocator_arg, allocator, std::forward<Args>(args)...) {
+  }
+
+  allocator_aware(const allocator_aware &other, allocator_type allocator = {})
+      : d_members(std::allocator_arg, allocator, other.d_members) {}
+
+  allocator_aware(allocator_aware &&other) = default;
+
+  allocator_aware(allocator_aware &&other, allocator_type allocator)
+      : d_members(std::allocator_arg, allocator, std::move(other.d_members)) {}
+
+  allocator_aware &operator=(const allocator_aware &other) = default;
+  allocator_aware &operator=(allocator_aware &&other) = default;
+
+  allocator_type get_allocator() const noexcept {
+    return std::get<k_source>(d_members).get_allocator();
+  }
+
+protected:
+  ~allocator_aware() = default;
+
+  template <std::size_t I> auto &member() noexcept {
+    return std::get<I>(d_members);
+  }
+  template <std::size_t I> const auto &member() const noexcept {
+    return std::get<I>(d_members);
+  }
+
+private:
+  std::tuple<Members...> d_members;
+};
+
+template <typename Derived, typename... Members>
+class indirect_allocator_aware {
+  static constexpr std::size_t k_source =
+      allocator_aware_detail::allocator_source<Members...>();
+  static_assert(k_source != sizeof...(Members),
+                "a member must use an allocator to borrow it from");
+
+public:
+  using allocator_type = allocator_aware_detail::allocator_type;
+
+  indirect_allocator_aware(allocator_type allocator = {})
+      : d_node(make_node(allocator)) {}
+
+  // Construct each member from the corresponding element of 'args'.
+  template <typename... Args,
+            typename = allocator_aware_detail::enable_if_member_args<
+                std::tuple<Members...>, Args...>>
+  indirect_allocator_aware(std::allocator_arg_t, allocator_type allocator,
+                           Args &&... args)
+      : d_node(make_node(allocator, std::forward<Args>(args)...)) {}
+
+  indirect_allocator_aware(const indirect_allocator_aware &other,
+                           allocator_type allocator = {})
+      : d_node(other.d_node ? make_node(allocator, other.d_node->d_members)
+                            : make_node(allocator)) {}
+
+  indirect_allocator_aware(indirect_allocator_aware &&other) noexcept
+      : d_node(std::exchange(other.d_node, nullptr)) {}
+
+  indirect_allocator_aware(indirect_allocator_aware &&other,
+                           allocator_type allocator) {
+    if (!other.d_node)
+      d_node = make_node(allocator);
+    else if (allocator == other.get_allocator())
+      d_node = std::exchange(other.d_node, nullptr);
+    else
+      d_node = make_node(allocator, std::move(other.d_node->d_members));
+  }
+
+  indirect_allocator_aware &operator=(const indirect_allocator_aware &other) {
+    if (this == &other)
+      return *this;
+    if (d_node && other.d_node)
+      d_node->d_members = other.d_node->d_members;
+    else {
+      indirect_allocator_aware copy(other, get_allocator());
+      std::swap(d_node, copy.d_node);
+    }
+    return *this;
+  }
+
+  indirect_allocator_aware &operator=(indirect_allocator_aware &&other) {
+    if (this == &other)
+      return *this;
+    if (!d_node || (other.d_node && get_allocator() == other.get_allocator()))
+      std::swap(d_node, other.d_node);
+    else if (other.d_node)
+      d_node->d_members = std::move(other.d_node->d_members);
+    else
+      d_node->d_members = members_type(std::allocator_arg, get_allocator());
+    return *this;
+  }
+
+  allocator_type get_allocator() const noexcept {
+    return d_node ? allocator_type(std::get<k_source>(d_node->d_members)
+                                       .get_allocator())
+                  : allocator_type();
+  }
+
+protected:
+  ~indirect_allocator_aware() {
+    if (d_node) {
+      std::pmr::memory_resource *const resource = get_allocator().resource();
+      d_node->~node();
+      resource->deallocate(d_node, sizeof(node), alignof(node));
+    }
+  }
+
+  template <std::size_t I> auto &member() noexcept {
+    return std::get<I>(d_node->d_members);
+  }
+  template <std::size_t I> const auto &member() const noexcept {
+    return std::get<I>(d_node->d_members);
+  }
+
+private:
+  using members_type = std::tuple<Members...>;
+
+  struct node {
+    template <typename... Args>
+    explicit node(allocator_type allocator, Args &&... args)
+        : d_members(std::allocator_arg, allocator,
+                    std::forward<Args>(args)...) {}
+
+    members_type d_members;
+  };
+
+  node *d_node;
+
+  template <typename... Args>
+  static node *make_node(allocator_type allocator, Args &&... args) {
+    void *const p =
+        allocator.resource()->allocate(sizeof(node), alignof(node));
+    try {
+      return ::new (p) node(allocator, std::forward<Args>(args)...);
+    } catch (...) {
+      allocator.resource()->deallocate(p, sizeof(node), alignof(node));
+      throw;
+    }
+  }
+};
+
+#endif
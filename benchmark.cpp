@@ -0,0 +1,129 @@
+#include <benchmark.hpp>
+#include <memory_resource.hpp>
+#include <simplicity.hpp>
+#include <small_vector.hpp>
+#include <vector.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+// Relate the per-element layouts of 'simplicity.cpp' (24 bytes for 'Foo6',
+// 16 for 'Foo8', and 8 for 'Foo9') to the cache behavior of building,
+// scanning, and destroying a vector of them, and check that the generated
+// 'Foo10' keeps up with the hand-written 'Foo9'. Then count the allocations
+// 'pmr::small_vector' saves for the 'Foo' of 'before_after.cpp'.
+
+namespace {
+
+constexpr std::size_t elementCount = 100000;
+
+template <typename FooN>
+void benchmark_layout(benchmark_table &table, const std::string &name,
+                      counting_resource &resource) {
+  std::pmr::vector<FooN> foos(std::pmr::polymorphic_allocator<FooN>{&resource});
+
+  table.run(name + " build", elementCount, resource, [&] {
+    for (std::size_t i = 0; i != elementCount; ++i)
+      foos.emplace_back();
+  });
+
+  table.run(name + " scan", elementCount, resource, [&] {
+    std::uintptr_t sink = 0;
+    for (FooN &foo : foos)
+      sink ^= reinterpret_cast<std::uintptr_t>(foo.get_allocator().resource());
+    do_not_optimize(sink);
+  });
+
+  table.run(name + " destroy", elementCount, resource, [&] {
+    std::pmr::vector<FooN> doomed(std::move(foos));
+  });
+}
+
+// The allocator-aware 'Foo' of 'before_after.cpp', with the type of 'd_v'
+// left open.
+template <typename Vector> struct IntsFoo {
+  using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+  IntsFoo(allocator_type alloc = {}) : d_v(alloc) {}
+  IntsFoo(const IntsFoo &other, allocator_type alloc = {})
+      : d_i(other.d_i), d_v(other.d_v, alloc) {}
+  IntsFoo(IntsFoo &&other) = default;
+  IntsFoo(IntsFoo &&other, allocator_type alloc)
+      : d_i(other.d_i), d_v(std::move(other.d_v), alloc) {}
+
+  allocator_type get_allocator() const noexcept { return d_v.get_allocator(); }
+
+  int d_i = 0;
+  Vector d_v;
+};
+
+template <typename FooN>
+void benchmark_ints(benchmark_table &table, const std::string &name,
+                    counting_resource &resource, int intsPerFoo) {
+  std::pmr::vector<FooN> foos(std::pmr::polymorphic_allocator<FooN>{&resource});
+  foos.reserve(elementCount);
+
+  table.run(name + " build", elementCount, resource, [&] {
+    for (std::size_t i = 0; i != elementCount; ++i) {
+      FooN &foo = foos.emplace_back();
+      for (int j = 0; j != intsPerFoo; ++j)
+        foo.d_v.push_back(j);
+    }
+  });
+
+  table.run(name + " scan", elementCount, resource, [&] {
+    long sum = 0;
+    for (const FooN &foo : foos)
+      for (int value : foo.d_v)
+        sum += value;
+    do_not_optimize(sum);
+  });
+
+  table.run(name + " destroy", elementCount, resource, [&] {
+    std::pmr::vector<FooN> doomed(std::move(foos));
+  });
+}
+
+} // namespace
+
+int main() {
+  counting_resource resource;
+
+  // The 'Foo's pick up the default resource in places; make it the counted
+  // one so that every allocator compares equal and all moves are cheap.
+  std::pmr::set_default_resource(&resource);
+
+  std::cout << "## sizeof(Foo6) = " << sizeof(Foo6) << std::endl;
+  std::cout << "## sizeof(Foo7) = " << sizeof(Foo7) << std::endl;
+  std::cout << "## sizeof(Foo8) = " << sizeof(Foo8) << std::endl;
+  std::cout << "## sizeof(Foo9) = " << sizeof(Foo9) << std::endl;
+  std::cout << "## sizeof(Foo10) = " << sizeof(Foo10) << std::endl;
+  std::cout << std::endl;
+
+  benchmark_table table;
+  table.header();
+  benchmark_layout<Foo6>(table, "Foo6", resource);
+  benchmark_layout<Foo7>(table, "Foo7", resource);
+  benchmark_layout<Foo8>(table, "Foo8", resource);
+  benchmark_layout<Foo9>(table, "Foo9", resource);
+  benchmark_layout<Foo10>(table, "Foo10", resource);
+
+  using VectorFoo = IntsFoo<std::pmr::vector<int>>;
+  using SmallFoo = IntsFoo<pmr::small_vector<int, 8>>;
+  std::cout << std::endl;
+  std::cout << "## sizeof(Foo with pmr::vector<int>) = " << sizeof(VectorFoo)
+            << std::endl;
+  std::cout << "## sizeof(Foo with pmr::small_vector<int, 8>) = "
+            << sizeof(SmallFoo) << std::endl;
+  std::cout << std::endl;
+
+  table.header();
+  benchmark_ints<VectorFoo>(table, "vector 4 ints", resource, 4);
+  benchmark_ints<SmallFoo>(table, "small_vector 4 ints", resource, 4);
+  benchmark_ints<VectorFoo>(table, "vector 16 ints", resource, 16);
+  benchmark_ints<SmallFoo>(table, "small_vector 16 ints", resource, 16);
+
+  std::pmr::set_default_resource(nullptr);
+}
@@ -0,0 +1,128 @@
+#ifndef BENCHMARK_HPP_
+#define BENCHMARK_HPP_
+
+// A small harness for the allocator benchmarks. Every measured region
+// reports, per operation, its wall-clock time, the allocations it made
+// through a 'counting_resource', and the hardware counters from
+// 'perf_counters.hpp' that the machine lets us read.
+
+#include <memory_resource.hpp>
+#include <perf_counters.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+// A resource that counts the allocations it forwards to 'underlyingResource'.
+class counting_resource : public std::pmr::memory_resource {
+public:
+  counting_resource(std::pmr::memory_resource *underlyingResource =
+                        std::pmr::new_delete_resource())
+      : d_underlyingResource(underlyingResource) {}
+
+  std::size_t allocations() const { return d_allocations; }
+  std::size_t deallocations() const { return d_deallocations; }
+  std::size_t bytes_allocated() const { return d_bytesAllocated; }
+  // Return the bytes allocated and not yet deallocated.
+  std::size_t bytes_in_use() const {
+    return d_bytesAllocated - d_bytesDeallocated;
+  }
+
+private:
+  std::pmr::memory_resource *d_underlyingResource;
+  std::size_t d_allocations = 0;
+  std::size_t d_deallocations = 0;
+  std::size_t d_bytesAllocated = 0;
+  std::size_t d_bytesDeallocated = 0;
+
+  void *do_allocate(size_t bytes, size_t align) override {
+    void *p = d_underlyingResource->allocate(bytes, align);
+    ++d_allocations;
+    d_bytesAllocated += bytes;
+    return p;
+  }
+  void do_deallocate(void *p, size_t bytes, size_t align) override {
+    ++d_deallocations;
+    d_bytesDeallocated += bytes;
+    return d_underlyingResource->deallocate(p, bytes, align);
+  }
+  bool do_is_equal(memory_resource const &other) const noexcept override {
+    return this == &other;
+  }
+};
+
+// Keep 'value' from being optimized away.
+template <typename T> inline void do_not_optimize(T const &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+class benchmark_table {
+public:
+  explicit benchmark_table(std::ostream &out = std::cout) : d_out(out) {}
+
+  // Print the column headings, noting when no hardware counter is readable.
+  void header() {
+    if (!d_counters.any_available())
+      d_out << "# hardware counters unavailable (is "
+               "/proc/sys/kernel/perf_event_paranoid too strict?)\n";
+    print_row("benchmark", "ns/op", "allocs/op", "bytes/op");
+    for (std::size_t i = 0; i != perf_event_count; ++i)
+      print_cell(perf_event_name(static_cast<perf_event>(i)));
+    d_out << '\n';
+  }
+
+  // Run 'body', which performs 'operations' operations allocating from
+  // 'resource', and print one row of per-operation results named 'name'.
+  template <typename Body>
+  void run(const std::string &name, std::size_t operations,
+           const counting_resource &resource, Body &&body) {
+    const std::size_t allocations = resource.allocations();
+    const std::size_t bytes = resource.bytes_allocated();
+
+    d_counters.start();
+    const auto begin = std::chrono::steady_clock::now();
+    body();
+    const auto end = std::chrono::steady_clock::now();
+    const perf_sample sample = d_counters.stop();
+
+    const double ops = operations ? static_cast<double>(operations) : 1.0;
+    const double ns =
+        std::chrono::duration<double, std::nano>(end - begin).count();
+    print_row(name, format(ns / ops),
+              format((resource.allocations() - allocations) / ops),
+              format((resource.bytes_allocated() - bytes) / ops));
+    for (const auto &value : sample.values)
+      print_cell(value ? format(*value / ops) : "n/a");
+    d_out << std::endl;
+  }
+
+private:
+  std::ostream &d_out;
+  perf_counters d_counters;
+
+  static std::string format(double value) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof buffer, "%.2f", value);
+    return buffer;
+  }
+
+  void print_cell(const std::string &text) {
+    char buffer[64];
+    std::snprintf(buffer, sizeof buffer, " %13s", text.c_str());
+    d_out << buffer;
+  }
+
+  void print_row(const std::string &name, const std::string &ns,
+                 const std::string &allocations, const std::string &bytes) {
+    char buffer[64];
+    std::snprintf(buffer, sizeof buffer, "%-32s", name.c_str());
+    d_out << buffer;
+    print_cell(ns);
+    print_cell(allocations);
+    print_cell(bytes);
+  }
+};
+
+#endif
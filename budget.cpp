@@ -0,0 +1,77 @@
+#include <budget_resource.hpp>
+#include <memory_resource.hpp>
+#include <string.hpp>
+#include <vector.hpp>
+
+#include <cstddef>
+#include <iostream>
+#include <new>
+
+// Two tenants share one upstream resource. The first one blows up; only its
+// own allocations fail.
+
+namespace {
+
+void print_usage(const char *name, const budget_resource &budget) {
+  std::cout << "  " << name << ": " << budget.used() << " of "
+            << budget.hard_limit() << " bytes"
+            << (budget.over_soft_limit() ? " (over soft limit)" : "")
+            << std::endl;
+}
+
+} // namespace
+
+int main() {
+  std::pmr::memory_resource *upstream = std::pmr::new_delete_resource();
+  budget_resource greedy(1024 * 1024, upstream);
+  budget_resource modest(1024 * 1024, upstream);
+  greedy.set_soft_limit(768 * 1024);
+  modest.set_soft_limit(768 * 1024);
+
+  std::cout << "## runaway tenant" << std::endl;
+  std::pmr::vector<std::pmr::string> greedyData(&greedy);
+  std::pmr::vector<std::pmr::string> modestData(&modest);
+  modestData.emplace_back(100, 'm');
+  try {
+    for (;;)
+      greedyData.emplace_back(1000, 'g');
+  } catch (const std::bad_alloc &) {
+    std::cout << "  greedy tenant hit its limit after " << greedyData.size()
+              << " strings" << std::endl;
+  }
+  print_usage("greedy", greedy);
+  print_usage("modest", modest);
+
+  // As in 'libcpp_bug.cpp', a failed 'emplace_back' must have no effects.
+  bool intact = true;
+  for (const std::pmr::string &s : greedyData)
+    intact = intact && s == std::pmr::string(1000, 'g');
+  std::cout << "  greedy tenant's strings intact: " << intact << std::endl;
+
+  modestData.emplace_back(100, 'm');
+  std::cout << "  modest tenant still allocates: " << modestData.size()
+            << " strings" << std::endl;
+
+  std::cout << "\n## shedding load on overflow" << std::endl;
+  greedyData.clear();
+  greedyData.shrink_to_fit();
+  std::pmr::vector<std::pmr::string> cache(&greedy);
+  for (int i = 0; i != 500; ++i)
+    cache.emplace_back(1000, 'c');
+
+  // The handler runs in the middle of an allocation, so it must not touch
+  // the container that is allocating. Dropping cache entries is fine.
+  std::size_t shed = 0;
+  greedy.set_overflow_handler([&](budget_resource &, std::size_t) {
+    if (cache.empty())
+      return false;
+    cache.pop_back();
+    ++shed;
+    return true;
+  });
+  for (int i = 0; i != 700; ++i)
+    greedyData.emplace_back(1000, 'g');
+  std::cout << "  shed " << shed << " cache entries, holding "
+            << greedyData.size() << " strings" << std::endl;
+  print_usage("greedy", greedy);
+}
@@ -0,0 +1,184 @@
+#ifndef BUDGET_RESOURCE_HPP_
+#define BUDGET_RESOURCE_HPP_
+
+// A resource that caps the bytes one tenant may have allocated from an
+// upstream resource at a time.
+//
+// Accounting is sharded to stay cheap when many threads allocate. Every
+// shard holds a credit of bytes already reserved against the hard limit, so
+// the common allocation and deallocation is a relaxed atomic operation on
+// the calling thread's shard. Only when a shard runs dry does it reserve a
+// fresh batch from the shared total. Reserved credit counts toward the
+// limit, so the limit is never exceeded, at the cost of up to one batch per
+// shard of headroom being unavailable to other threads until it is reclaimed.
+//
+// A request that would exceed the hard limit invokes the overflow handler,
+// which may free memory (shed load, drop caches, compact) and ask for a
+// retry. Without a handler, or when it declines, 'std::bad_alloc' is thrown
+// before the upstream resource is touched, so containers see an ordinary
+// allocation failure.
+
+#include <memory_resource.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <new>
+
+class budget_resource : public std::pmr::memory_resource {
+public:
+  // Called with the resource and the request size when a request doesn't
+  // fit. Return true to retry the request, false to fail it.
+  using overflow_handler = std::function<bool(budget_resource &, std::size_t)>;
+
+  explicit budget_resource(std::size_t hardLimit,
+                           std::pmr::memory_resource *upstream =
+                               std::pmr::get_default_resource())
+      : d_upstream(upstream), d_hardLimit(hardLimit), d_softLimit(hardLimit),
+        d_batch(std::clamp<std::size_t>(hardLimit / (k_shards * 8), 1,
+                                        k_maxBatch)) {}
+
+  budget_resource(const budget_resource &) = delete;
+  budget_resource &operator=(const budget_resource &) = delete;
+
+  std::size_t hard_limit() const { return d_hardLimit; }
+
+  // The watermark above which 'over_soft_limit' reports backpressure.
+  std::size_t soft_limit() const { return d_softLimit; }
+  void set_soft_limit(std::size_t limit) {
+    d_softLimit = std::min(limit, d_hardLimit);
+  }
+
+  // Not thread-safe; install the handler before sharing the resource.
+  void set_overflow_handler(overflow_handler handler) {
+    d_handler = std::move(handler);
+  }
+
+  // Return the bytes currently allocated. This is a relaxed snapshot and may
+  // be slightly stale when other threads are allocating.
+  std::size_t used() const {
+    std::int64_t credit = 0;
+    for (const shard &s : d_shards)
+      credit += s.d_credit.load(std::memory_order_relaxed);
+    const std::int64_t reserved = d_reserved.load(std::memory_order_relaxed);
+    return static_cast<std::size_t>(std::max<std::int64_t>(reserved - credit,
+                                                           0));
+  }
+
+  // Return true when callers should start shedding load.
+  bool over_soft_limit() const { return used() >= d_softLimit; }
+
+  std::pmr::memory_resource *upstream_resource() const { return d_upstream; }
+
+private:
+  static constexpr std::size_t k_shards = 16;
+  static constexpr std::size_t k_maxBatch = 64 * 1024;
+
+  struct alignas(64) shard {
+    std::atomic<std::int64_t> d_credit{0};
+  };
+
+  std::pmr::memory_resource *d_upstream;
+  const std::size_t d_hardLimit;
+  std::size_t d_softLimit;
+  const std::size_t d_batch;
+  overflow_handler d_handler;
+  std::atomic<std::int64_t> d_reserved{0}; // credit plus bytes in use
+  std::array<shard, k_shards> d_shards;
+
+  // Threads take shards round robin, in the order they first get here.
+  // Hashing 'std::thread::id' instead can send every thread to one shard:
+  // libc++ hashes it to the 'pthread_t', whose low bits rarely differ.
+  shard &this_thread_shard() {
+    static std::atomic<std::size_t> nextIndex{0};
+    static thread_local const std::size_t index =
+        nextIndex.fetch_add(1, std::memory_order_relaxed);
+    return d_shards[index % k_shards];
+  }
+
+  // Take 'bytes' from the shard's credit, returning false if it's short.
+  static bool take_credit(shard &s, std::int64_t bytes) {
+    std::int64_t credit = s.d_credit.load(std::memory_order_relaxed);
+    while (credit >= bytes)
+      if (s.d_credit.compare_exchange_weak(credit, credit - bytes,
+                                           std::memory_order_relaxed))
+        return true;
+    return false;
+  }
+
+  // Reserve 'bytes' against the hard limit, returning false if that would
+  // exceed it.
+  bool reserve(std::int64_t bytes) {
+    std::int64_t reserved = d_reserved.load(std::memory_order_relaxed);
+    do {
+      if (reserved + bytes > static_cast<std::int64_t>(d_hardLimit))
+        return false;
+    } while (!d_reserved.compare_exchange_weak(reserved, reserved + bytes,
+                                               std::memory_order_relaxed));
+    return true;
+  }
+
+  // Return every shard's unused credit to the shared total.
+  void reclaim_credit() {
+    for (shard &s : d_shards)
+      d_reserved.fetch_sub(s.d_credit.exchange(0, std::memory_order_relaxed),
+                           std::memory_order_relaxed);
+  }
+
+  // Charge 'bytes' to the budget, returning false if it doesn't fit.
+  bool charge(shard &s, std::int64_t bytes) {
+    if (take_credit(s, bytes))
+      return true;
+    const std::int64_t batch = static_cast<std::int64_t>(d_batch);
+    if (reserve(bytes + batch)) {
+      s.d_credit.fetch_add(batch, std::memory_order_relaxed);
+      return true;
+    }
+    if (reserve(bytes))
+      return true;
+    reclaim_credit();
+    return reserve(bytes);
+  }
+
+  void refund(shard &s, std::int64_t bytes) {
+    const std::int64_t batch = static_cast<std::int64_t>(d_batch);
+    std::int64_t credit =
+        s.d_credit.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    // Keep at most two batches of credit per shard.
+    while (credit > 2 * batch) {
+      if (s.d_credit.compare_exchange_weak(credit, batch,
+                                           std::memory_order_relaxed)) {
+        d_reserved.fetch_sub(credit - batch, std::memory_order_relaxed);
+        break;
+      }
+    }
+  }
+
+  void *do_allocate(size_t bytes, size_t align) override {
+    shard &s = this_thread_shard();
+    const std::int64_t charged = static_cast<std::int64_t>(bytes);
+    while (!charge(s, charged))
+      if (!d_handler || !d_handler(*this, bytes))
+        throw std::bad_alloc();
+    try {
+      return d_upstream->allocate(bytes, align);
+    } catch (...) {
+      refund(s, charged);
+      throw;
+    }
+  }
+
+  void do_deallocate(void *p, size_t bytes, size_t align) override {
+    d_upstream->deallocate(p, bytes, align);
+    refund(this_thread_shard(), static_cast<std::int64_t>(bytes));
+  }
+
+  bool do_is_equal(memory_resource const &other) const noexcept override {
+    return this == &other;
+  }
+};
+
+#endif
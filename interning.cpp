@@ -0,0 +1,105 @@
+#include <benchmark.hpp>
+#include <memory_resource.hpp>
+#include <string.hpp>
+#include <string_interner.hpp>
+#include <vector.hpp>
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+// Compare records keyed by 'std::pmr::string', as 'Bar9' is, with records
+// keyed by 'interned_string' when the same few keys repeat many times.
+
+namespace {
+
+constexpr std::size_t recordCount = 1000000;
+constexpr std::size_t distinctKeys = 100;
+
+class Bar9Record {
+public:
+  using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+  Bar9Record(std::string_view key, allocator_type allocator = {})
+      : d_key(key, allocator) {}
+  Bar9Record(const Bar9Record &other, allocator_type allocator = {})
+      : d_key(other.d_key, allocator) {}
+  Bar9Record(Bar9Record &&other) noexcept = default;
+  Bar9Record(Bar9Record &&other, allocator_type allocator)
+      : d_key(std::move(other.d_key), allocator) {}
+
+  const std::pmr::string &key() const { return d_key; }
+
+private:
+  std::pmr::string d_key;
+};
+
+// Needs no allocator: the key's bytes belong to the interner.
+class InternedRecord {
+public:
+  explicit InternedRecord(interned_string key) : d_key(key) {}
+
+  interned_string key() const { return d_key; }
+
+private:
+  interned_string d_key;
+};
+
+std::string key_text(std::size_t i) {
+  return "service.request.latency.histogram.bucket." +
+         std::to_string(i % distinctKeys);
+}
+
+} // namespace
+
+int main() {
+  std::cout << "## sizeof(Bar9Record) = " << sizeof(Bar9Record) << std::endl;
+  std::cout << "## sizeof(InternedRecord) = " << sizeof(InternedRecord)
+            << std::endl;
+  std::cout << std::endl;
+
+  std::vector<std::string> texts;
+  for (std::size_t i = 0; i != recordCount; ++i)
+    texts.push_back(key_text(i));
+
+  benchmark_table table;
+  table.header();
+
+  counting_resource stringResource;
+  std::pmr::vector<Bar9Record> strings(&stringResource);
+  strings.reserve(recordCount);
+  table.run("pmr::string build", recordCount, stringResource, [&] {
+    for (const std::string &text : texts)
+      strings.emplace_back(text);
+  });
+
+  counting_resource internedResource;
+  string_interner interner(&internedResource);
+  std::pmr::vector<InternedRecord> interned(&internedResource);
+  interned.reserve(recordCount);
+  table.run("interned build", recordCount, internedResource, [&] {
+    for (const std::string &text : texts)
+      interned.emplace_back(interner.intern(text));
+  });
+
+  table.run("pmr::string compare", recordCount, stringResource, [&] {
+    std::size_t matches = 0;
+    for (std::size_t i = 1; i != strings.size(); ++i)
+      matches += strings[i].key() == strings[i - 1].key();
+    do_not_optimize(matches);
+  });
+
+  table.run("interned compare", recordCount, internedResource, [&] {
+    std::size_t matches = 0;
+    for (std::size_t i = 1; i != interned.size(); ++i)
+      matches += interned[i].key() == interned[i - 1].key();
+    do_not_optimize(matches);
+  });
+
+  std::cout << "\n## " << interner.size() << " distinct keys" << std::endl;
+  std::cout << "## pmr::string records allocated "
+            << stringResource.bytes_allocated() << " bytes" << std::endl;
+  std::cout << "## interned records allocated "
+            << internedResource.bytes_allocated() << " bytes" << std::endl;
+}
@@ -4,6 +4,10 @@
 // header <memory_resource>
 #include <experimental/memory_resource>
 
+#include <cstddef>
+#include <memory>
+#include <new>
+
 #if __has_include(<bdlma_bufferedsequentialallocator.h>)
 #include <bdlma_bufferedsequentialallocator.h>
 #endif
@@ -26,20 +30,71 @@ using std::experimental::fundamentals_v1::pmr::new_delete_resource;
 #endif
 
 #ifdef INCLUDED_BDLMA_BUFFEREDSEQUENTIALALLOCATOR
+// The constructors that take no buffer obtain one of 'initialSize' bytes
+// from 'underlyingResource', so that this class offers the same constructors
+// as the portable one below.
 class monotonic_buffer_resource : public std::pmr::memory_resource {
-    BloombergLP::bdlma::BufferedSequentialAllocator  d_bsa;
+    static constexpr std::size_t k_DEFAULT_SIZE = 1024;
+
     std::pmr::memory_resource                       *d_underlyingResource;
+    void                                            *d_ownedBuffer;
+    std::size_t                                      d_ownedSize;
+    BloombergLP::bdlma::BufferedSequentialAllocator  d_bsa;
 
   public:
+    explicit monotonic_buffer_resource(
+              std::pmr::memory_resource *underlyingResource =
+                                             std::pmr::get_default_resource())
+    : monotonic_buffer_resource(k_DEFAULT_SIZE, underlyingResource)
+    {
+    }
+
+    monotonic_buffer_resource(std::size_t                initialSize,
+                              std::pmr::memory_resource *underlyingResource =
+                                             std::pmr::get_default_resource())
+    : d_underlyingResource(underlyingResource)
+    , d_ownedBuffer(underlyingResource->allocate(
+                                   initialSize ? initialSize : k_DEFAULT_SIZE))
+    , d_ownedSize(initialSize ? initialSize : k_DEFAULT_SIZE)
+    , d_bsa(static_cast<char *>(d_ownedBuffer),
+            d_ownedSize)  // todo, needs underlying resource
+    {
+    }
+
     monotonic_buffer_resource(void                      *buffer,
                               std::size_t                size,
-                              std::pmr::memory_resource *underlyingResource)
-    : d_bsa(static_cast<char *>(buffer),
+                              std::pmr::memory_resource *underlyingResource =
+                                             std::pmr::get_default_resource())
+    : d_underlyingResource(underlyingResource)
+    , d_ownedBuffer(nullptr)
+    , d_ownedSize(0)
+    , d_bsa(static_cast<char *>(buffer),
             size)  // todo, needs underlying resource
-    , d_underlyingResource(underlyingResource)
     {
     }
 
+    monotonic_buffer_resource(const monotonic_buffer_resource&) = delete;
+    monotonic_buffer_resource& operator=(
+                                   const monotonic_buffer_resource&) = delete;
+
+    ~monotonic_buffer_resource() override
+    {
+        d_bsa.release();
+        if (d_ownedBuffer) {
+            d_underlyingResource->deallocate(d_ownedBuffer, d_ownedSize);
+        }
+    }
+
+    std::pmr::memory_resource *upstream_resource() const
+    {
+        return d_underlyingResource;
+    }
+
+    void release()
+    {
+        d_bsa.release();
+    }
+
   private:
     void *do_allocate(size_t bytes, size_t align) override
     {
@@ -54,6 +109,119 @@ class monotonic_buffer_resource : public std::pmr::memory_resource {
         return d_underlyingResource->is_equal(other);
     }
 };
+#else
+// A portable 'monotonic_buffer_resource' for when BDE isn't available. It
+// hands out memory from 'buffer' and then from geometrically growing chunks
+// obtained from 'underlyingResource'; deallocation is a no-op and 'release'
+// returns every chunk at once.
+class monotonic_buffer_resource : public std::pmr::memory_resource {
+    struct Chunk {
+        Chunk       *d_next;
+        std::size_t  d_size;
+    };
+
+    static constexpr std::size_t k_DEFAULT_SIZE = 1024;
+
+    char                      *d_initialBuffer;
+    std::size_t                d_initialSize;
+    char                      *d_current;
+    std::size_t                d_space;
+    std::size_t                d_nextSize;
+    std::size_t                d_initialNextSize;
+    Chunk                     *d_chunks = nullptr;
+    std::pmr::memory_resource *d_underlyingResource;
+
+  public:
+    explicit monotonic_buffer_resource(
+              std::pmr::memory_resource *underlyingResource =
+                                             std::pmr::get_default_resource())
+    : monotonic_buffer_resource(nullptr, 0, underlyingResource)
+    {
+    }
+
+    monotonic_buffer_resource(std::size_t                initialSize,
+                              std::pmr::memory_resource *underlyingResource =
+                                             std::pmr::get_default_resource())
+    : monotonic_buffer_resource(nullptr, 0, underlyingResource)
+    {
+        d_nextSize = d_initialNextSize =
+                                   initialSize ? initialSize : k_DEFAULT_SIZE;
+    }
+
+    monotonic_buffer_resource(void                      *buffer,
+                              std::size_t                size,
+                              std::pmr::memory_resource *underlyingResource =
+                                             std::pmr::get_default_resource())
+    : d_initialBuffer(static_cast<char *>(buffer))
+    , d_initialSize(size)
+    , d_current(d_initialBuffer)
+    , d_space(size)
+    , d_nextSize(size ? size * 2 : k_DEFAULT_SIZE)
+    , d_initialNextSize(d_nextSize)
+    , d_underlyingResource(underlyingResource)
+    {
+    }
+
+    monotonic_buffer_resource(const monotonic_buffer_resource&) = delete;
+    monotonic_buffer_resource& operator=(
+                                   const monotonic_buffer_resource&) = delete;
+
+    ~monotonic_buffer_resource() override
+    {
+        release();
+    }
+
+    // Return every chunk to the underlying resource and start over from the
+    // initial buffer, growing from the constructed chunk size again.
+    void release()
+    {
+        while (d_chunks) {
+            Chunk *const next = d_chunks->d_next;
+            d_underlyingResource->deallocate(d_chunks,
+                                             d_chunks->d_size,
+                                             alignof(std::max_align_t));
+            d_chunks = next;
+        }
+        d_current  = d_initialBuffer;
+        d_space    = d_initialSize;
+        d_nextSize = d_initialNextSize;
+    }
+
+    std::pmr::memory_resource *upstream_resource() const
+    {
+        return d_underlyingResource;
+    }
+
+  private:
+    void *do_allocate(size_t bytes, size_t align) override
+    {
+        void *p = d_current;
+        if (!std::align(align, bytes, p, d_space)) {
+            std::size_t size = d_nextSize;
+            while (size < sizeof(Chunk) + bytes + align) {
+                size *= 2;
+            }
+            void *const memory = d_underlyingResource->allocate(
+                                            size, alignof(std::max_align_t));
+            d_chunks   = ::new (memory) Chunk{d_chunks, size};
+            d_current  = static_cast<char *>(memory) + sizeof(Chunk);
+            d_space    = size - sizeof(Chunk);
+            d_nextSize = size * 2;
+            p          = d_current;
+            std::align(align, bytes, p, d_space);
+        }
+        d_current = static_cast<char *>(p) + bytes;
+        d_space  -= bytes;
+        return p;
+    }
+    void do_deallocate(void *p, size_t bytes, size_t align) override
+    {
+    }
+    bool do_is_equal(memory_resource const& other) const noexcept override
+    {
+        return this == &other;
+    }
+};
 #endif
 }
 
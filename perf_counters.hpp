@@ -0,0 +1,187 @@
+#ifndef PERF_COUNTERS_HPP_
+#define PERF_COUNTERS_HPP_
+
+// Hardware performance counters read through Linux's 'perf_event_open'. Each
+// event is opened on its own so that a counter the CPU (or a virtual machine)
+// doesn't provide only disables that column. When the kernel refuses access
+// altogether (see '/proc/sys/kernel/perf_event_paranoid') or the platform
+// isn't Linux, every counter simply reports as unavailable.
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#if __has_include(<linux/perf_event.h>)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define PERF_COUNTERS_HAVE_PERF_EVENT 1
+#endif
+
+enum class perf_event {
+  cycles,
+  instructions,
+  l1d_misses,
+  llc_misses,
+  dtlb_misses,
+  branch_misses,
+};
+
+inline constexpr std::size_t perf_event_count = 6;
+
+inline const char *perf_event_name(perf_event event) {
+  switch (event) {
+  case perf_event::cycles:
+    return "cycles";
+  case perf_event::instructions:
+    return "instructions";
+  case perf_event::l1d_misses:
+    return "L1d-misses";
+  case perf_event::llc_misses:
+    return "LLC-misses";
+  case perf_event::dtlb_misses:
+    return "dTLB-misses";
+  case perf_event::branch_misses:
+    return "branch-misses";
+  }
+  return "?";
+}
+
+// The counter values of one measured region. An empty optional means the
+// counter could not be opened.
+struct perf_sample {
+  std::array<std::optional<std::uint64_t>, perf_event_count> values{};
+
+  std::optional<std::uint64_t> operator[](perf_event event) const {
+    return values[static_cast<std::size_t>(event)];
+  }
+};
+
+class perf_counters {
+public:
+  perf_counters() {
+    d_fds.fill(-1);
+#ifdef PERF_COUNTERS_HAVE_PERF_EVENT
+    for (std::size_t i = 0; i != perf_event_count; ++i)
+      d_fds[i] = open(static_cast<perf_event>(i));
+#endif
+  }
+
+  perf_counters(const perf_counters &) = delete;
+  perf_counters &operator=(const perf_counters &) = delete;
+
+  ~perf_counters() {
+#ifdef PERF_COUNTERS_HAVE_PERF_EVENT
+    for (int fd : d_fds)
+      if (fd != -1)
+        ::close(fd);
+#endif
+  }
+
+  bool available(perf_event event) const {
+    return d_fds[static_cast<std::size_t>(event)] != -1;
+  }
+
+  bool any_available() const {
+    for (int fd : d_fds)
+      if (fd != -1)
+        return true;
+    return false;
+  }
+
+  // Zero and enable every available counter.
+  void start() {
+#ifdef PERF_COUNTERS_HAVE_PERF_EVENT
+    for (int fd : d_fds)
+      if (fd != -1)
+        ::ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    for (int fd : d_fds)
+      if (fd != -1)
+        ::ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+  }
+
+  // Disable every available counter and return the values accumulated since
+  // the last 'start'. Values are scaled up when the kernel had to multiplex
+  // more events than the PMU has registers.
+  perf_sample stop() {
+    perf_sample result;
+#ifdef PERF_COUNTERS_HAVE_PERF_EVENT
+    for (int fd : d_fds)
+      if (fd != -1)
+        ::ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    for (std::size_t i = 0; i != perf_event_count; ++i) {
+      if (d_fds[i] == -1)
+        continue;
+      // Layout given by 'read_format' below.
+      std::uint64_t data[3] = {};
+      if (::read(d_fds[i], data, sizeof data) != sizeof data)
+        continue;
+      const std::uint64_t value = data[0];
+      const std::uint64_t enabled = data[1];
+      const std::uint64_t running = data[2];
+      if (running == 0)
+        result.values[i] = 0;
+      else if (running == enabled)
+        result.values[i] = value;
+      else
+        result.values[i] = static_cast<std::uint64_t>(
+            static_cast<double>(value) * enabled / running);
+    }
+#endif
+    return result;
+  }
+
+private:
+  std::array<int, perf_event_count> d_fds;
+
+#ifdef PERF_COUNTERS_HAVE_PERF_EVENT
+  static int open(perf_event event) {
+    perf_event_attr attr{};
+    attr.size = sizeof attr;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format =
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    constexpr auto readMiss =
+        (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    switch (event) {
+    case perf_event::cycles:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_CPU_CYCLES;
+      break;
+    case perf_event::instructions:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+      break;
+    case perf_event::l1d_misses:
+      attr.type = PERF_TYPE_HW_CACHE;
+      attr.config = PERF_COUNT_HW_CACHE_L1D | readMiss;
+      break;
+    case perf_event::llc_misses:
+      attr.type = PERF_TYPE_HW_CACHE;
+      attr.config = PERF_COUNT_HW_CACHE_LL | readMiss;
+      break;
+    case perf_event::dtlb_misses:
+      attr.type = PERF_TYPE_HW_CACHE;
+      attr.config = PERF_COUNT_HW_CACHE_DTLB | readMiss;
+      break;
+    case perf_event::branch_misses:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+      break;
+    }
+
+    // Measure this thread on any CPU.
+    const long fd = ::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    return fd < 0 ? -1 : static_cast<int>(fd);
+  }
+#endif
+};
+
+#endif
@@ -0,0 +1,456 @@
+#ifndef POOL_RESOURCE_HPP_
+#define POOL_RESOURCE_HPP_
+
+// Pool resources in the spirit of C++17's
+// 'std::pmr::unsynchronized_pool_resource' and
+// 'std::pmr::synchronized_pool_resource'. Requests are rounded up to a
+// power-of-two block size and served from chunks obtained from the upstream
+// resource; requests larger than the largest block go straight upstream.
+//
+// Each chunk tracks its free blocks in a bitmap rather than an intrusive
+// free list so that the contents of free blocks are never read. Chunks are
+// page-aligned. Together these let the pool give memory back after a burst:
+// once a chunk has gone without allocations or deallocations for the decay
+// period, it is returned upstream if it is entirely free, and otherwise its
+// pages made up only of free blocks are handed back to the kernel with
+// 'madvise' (if 'release_free_pages' allows it). Quiet periods are observed
+// by 'scavenge', so they are only as precise as the interval between calls.
+
+#include <memory_resource.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if __has_include(<sys/mman.h>)
+#include <sys/mman.h>
+#define POOL_RESOURCE_HAVE_MADVISE 1
+#endif
+
+struct pool_options {
+  // The most blocks a single chunk may hold. Zero selects a default.
+  std::size_t max_blocks_per_chunk = 0;
+  // Requests larger than this bypass the pools. Zero selects a default.
+  std::size_t largest_required_pool_block = 0;
+  // How long a chunk must go without allocations or deallocations before
+  // 'scavenge' gives its free memory back.
+  std::chrono::steady_clock::duration decay = std::chrono::seconds(1);
+  // Whether 'scavenge' and 'trim' may 'madvise' away pages of free blocks.
+  // Only enable this when the upstream hands out ordinary private anonymous
+  // memory, as 'new' and 'malloc' do.
+  bool release_free_pages = false;
+};
+
+class pool_resource : public std::pmr::memory_resource {
+public:
+  explicit pool_resource(std::pmr::memory_resource *upstream =
+                             std::pmr::get_default_resource())
+      : pool_resource(pool_options{}, upstream) {}
+
+  pool_resource(const pool_options &options,
+                std::pmr::memory_resource *upstream =
+                    std::pmr::get_default_resource())
+      : d_upstream(upstream), d_options(options) {
+    if (d_options.max_blocks_per_chunk == 0)
+      d_options.max_blocks_per_chunk = k_defaultChunkBytes / k_smallestBlock;
+    if (d_options.largest_required_pool_block == 0)
+      d_options.largest_required_pool_block = k_pageSize;
+    d_options.largest_required_pool_block = std::min(
+        round_up(d_options.largest_required_pool_block), k_defaultChunkBytes);
+
+    for (std::size_t block = k_smallestBlock;
+         block <= d_options.largest_required_pool_block; block *= 2) {
+      pool p;
+      p.d_blockSize = block;
+      p.d_blocksPerChunk = std::max<std::size_t>(
+          1, std::min(d_options.max_blocks_per_chunk,
+                      k_defaultChunkBytes / block));
+      d_pools.push_back(std::move(p));
+    }
+  }
+
+  pool_resource(const pool_resource &) = delete;
+  pool_resource &operator=(const pool_resource &) = delete;
+
+  ~pool_resource() override { release(); }
+
+  // Return every chunk to the upstream resource, whether or not its blocks
+  // have been deallocated.
+  void release() {
+    for (pool &p : d_pools) {
+      for (auto &entry : p.d_chunks)
+        d_upstream->deallocate(entry.second->d_memory, chunk_bytes(p),
+                               chunk_alignment(p));
+      p.d_chunks.clear();
+      p.d_available.clear();
+    }
+    d_retainedBytes = 0;
+    d_inUseBytes = 0;
+    d_discardedBytes = 0;
+  }
+
+  // Give back the free memory of the chunks that have gone without
+  // allocations or deallocations for at least the decay period: return them
+  // upstream if they are entirely free, or release their pages of free
+  // blocks if not. Return the number of bytes given back.
+  std::size_t scavenge() {
+    const auto now = std::chrono::steady_clock::now();
+    for (pool &p : d_pools) {
+      for (auto &entry : p.d_chunks) {
+        chunk &c = *entry.second;
+        if (c.d_touched)
+          c.d_quietSince = now;
+        c.d_touched = false;
+      }
+    }
+    const auto quiet = [cutoff = now - d_options.decay](const chunk &c) {
+      return c.d_quietSince <= cutoff;
+    };
+    std::size_t released = release_chunks(quiet, 0);
+    released += release_pages(quiet, 0);
+    return released;
+  }
+
+  // Give memory back, free chunks first and then pages of free blocks,
+  // until no more than 'targetBytes' are retained or nothing is left to
+  // give. Return the number of bytes given back.
+  std::size_t trim(std::size_t targetBytes = 0) {
+    const auto any = [](const chunk &) { return true; };
+    std::size_t released = release_chunks(any, targetBytes);
+    if (retained_bytes() > targetBytes)
+      released += release_pages(any, targetBytes);
+    return released;
+  }
+
+  // Return the bytes obtained from upstream for pooled blocks, excluding
+  // pages released to the kernel.
+  std::size_t retained_bytes() const {
+    return d_retainedBytes - d_discardedBytes;
+  }
+
+  // Return the bytes of pooled blocks currently allocated.
+  std::size_t in_use_bytes() const { return d_inUseBytes; }
+
+  std::pmr::memory_resource *upstream_resource() const { return d_upstream; }
+
+  pool_options options() const { return d_options; }
+
+protected:
+  void *do_allocate(size_t bytes, size_t align) override {
+    pool *const p = find_pool(bytes, align);
+    if (!p)
+      return d_upstream->allocate(bytes, align);
+
+    while (!p->d_available.empty() &&
+           p->d_available.back()->d_freeBlocks == 0) {
+      p->d_available.back()->d_available = false;
+      p->d_available.pop_back();
+    }
+    if (p->d_available.empty()) {
+      p->d_available.reserve(p->d_chunks.size() + 1);
+      chunk *const c = new_chunk(*p);
+      c->d_available = true;
+      p->d_available.push_back(c);
+    }
+
+    chunk &c = *p->d_available.back();
+    while (c.d_free[c.d_hint] == 0)
+      ++c.d_hint;
+    std::uint64_t &word = c.d_free[c.d_hint];
+    const std::size_t index = c.d_hint * 64 + __builtin_ctzll(word);
+    word &= word - 1;
+    --c.d_freeBlocks;
+    d_inUseBytes += p->d_blockSize;
+    c.d_touched = true;
+    if (c.d_discardedPages != 0)
+      touch_pages(*p, c, index);
+    return c.d_memory + index * p->d_blockSize;
+  }
+
+  void do_deallocate(void *ptr, size_t bytes, size_t align) override {
+    pool *const p = find_pool(bytes, align);
+    if (!p)
+      return d_upstream->deallocate(ptr, bytes, align);
+
+    chunk &c = owning_chunk(*p, ptr);
+    const std::size_t index =
+        (static_cast<char *>(ptr) - c.d_memory) / p->d_blockSize;
+    c.d_free[index / 64] |= std::uint64_t(1) << (index % 64);
+    c.d_hint = std::min(c.d_hint, index / 64);
+    ++c.d_freeBlocks;
+    d_inUseBytes -= p->d_blockSize;
+    c.d_touched = true;
+    if (!c.d_available) {
+      c.d_available = true;
+      p->d_available.push_back(&c);
+    }
+  }
+
+  bool do_is_equal(memory_resource const &other) const noexcept override {
+    return this == &other;
+  }
+
+private:
+  static constexpr std::size_t k_smallestBlock = 8;
+  static constexpr std::size_t k_pageSize = 4096;
+  static constexpr std::size_t k_defaultChunkBytes = 64 * 1024;
+
+  struct chunk {
+    char *d_memory;
+    std::size_t d_freeBlocks;
+    std::size_t d_hint = 0; // first bitmap word that may have a free block
+    bool d_available = false;
+    std::vector<std::uint64_t> d_free; // one bit per block, set when free
+    bool d_touched = true; // used since the last 'scavenge'
+    std::chrono::steady_clock::time_point d_quietSince;
+    std::vector<bool> d_discarded; // one per page, set when 'madvise'd
+    std::size_t d_discardedPages = 0;
+  };
+
+  struct pool {
+    std::size_t d_blockSize;
+    std::size_t d_blocksPerChunk;
+    std::map<char *, std::unique_ptr<chunk>> d_chunks; // by start address
+    std::vector<chunk *> d_available; // chunks that may have free blocks
+  };
+
+  std::pmr::memory_resource *d_upstream;
+  pool_options d_options;
+  std::vector<pool> d_pools;
+  std::size_t d_retainedBytes = 0;
+  std::size_t d_inUseBytes = 0;
+  std::size_t d_discardedBytes = 0;
+
+  static std::size_t round_up(std::size_t bytes) {
+    std::size_t block = k_smallestBlock;
+    while (block < bytes)
+      block *= 2;
+    return block;
+  }
+
+  static std::size_t chunk_bytes(const pool &p) {
+    return p.d_blockSize * p.d_blocksPerChunk;
+  }
+
+  // Return the largest power of two no greater than a chunk or a page. A
+  // chunk's size needn't be a power of two, since 'max_blocks_per_chunk'
+  // isn't, but an alignment must be; it's still at least a block.
+  static std::size_t chunk_alignment(const pool &p) {
+    const std::size_t bytes = std::min(chunk_bytes(p), k_pageSize);
+    std::size_t result = 1;
+    while (result * 2 <= bytes)
+      result *= 2;
+    return result;
+  }
+
+  static bool is_free(const chunk &c, std::size_t index) {
+    return c.d_free[index / 64] >> (index % 64) & 1;
+  }
+
+  // Return the pool serving 'bytes' at 'align', or null if the request must
+  // go upstream.
+  pool *find_pool(std::size_t bytes, std::size_t align) {
+    const std::size_t size = std::max(bytes, align);
+    if (size > d_options.largest_required_pool_block || align > k_pageSize)
+      return nullptr;
+    std::size_t index = 0;
+    for (std::size_t block = k_smallestBlock; block < size; block *= 2)
+      ++index;
+    return &d_pools[index];
+  }
+
+  chunk *new_chunk(pool &p) {
+    auto c = std::make_unique<chunk>();
+    c->d_free.assign((p.d_blocksPerChunk + 63) / 64, 0);
+    for (std::size_t i = 0; i != p.d_blocksPerChunk; ++i)
+      c->d_free[i / 64] |= std::uint64_t(1) << (i % 64);
+    c->d_freeBlocks = p.d_blocksPerChunk;
+    c->d_discarded.assign(chunk_bytes(p) / k_pageSize, false);
+    c->d_memory = static_cast<char *>(
+        d_upstream->allocate(chunk_bytes(p), chunk_alignment(p)));
+    chunk *const result = c.get();
+    try {
+      p.d_chunks.emplace(result->d_memory, std::move(c));
+    } catch (...) {
+      d_upstream->deallocate(result->d_memory, chunk_bytes(p),
+                             chunk_alignment(p));
+      throw;
+    }
+    d_retainedBytes += chunk_bytes(p);
+    return result;
+  }
+
+  chunk &owning_chunk(pool &p, void *ptr) {
+    auto it = p.d_chunks.upper_bound(static_cast<char *>(ptr));
+    assert(it != p.d_chunks.begin());
+    --it;
+    assert(static_cast<char *>(ptr) < it->first + chunk_bytes(p));
+    return *it->second;
+  }
+
+  // Note that the pages under block 'index' of 'c' are in use again.
+  void touch_pages(const pool &p, chunk &c, std::size_t index) {
+    const std::size_t first = index * p.d_blockSize / k_pageSize;
+    const std::size_t last = ((index + 1) * p.d_blockSize - 1) / k_pageSize;
+    for (std::size_t page = first; page <= last && page < c.d_discarded.size();
+         ++page) {
+      if (c.d_discarded[page]) {
+        c.d_discarded[page] = false;
+        --c.d_discardedPages;
+        d_discardedBytes -= k_pageSize;
+      }
+    }
+  }
+
+  // Return upstream the entirely free chunks satisfying 'eligible' until at
+  // most 'targetBytes' are retained.
+  template <typename Eligible>
+  std::size_t release_chunks(Eligible eligible, std::size_t targetBytes) {
+    std::size_t released = 0;
+    for (pool &p : d_pools) {
+      for (auto it = p.d_chunks.begin(); it != p.d_chunks.end();) {
+        if (retained_bytes() <= targetBytes)
+          return released;
+        chunk &c = *it->second;
+        if (c.d_freeBlocks != p.d_blocksPerChunk || !eligible(c)) {
+          ++it;
+          continue;
+        }
+        if (c.d_available)
+          p.d_available.erase(std::find(p.d_available.begin(),
+                                        p.d_available.end(), &c));
+        released += chunk_bytes(p) - c.d_discardedPages * k_pageSize;
+        d_retainedBytes -= chunk_bytes(p);
+        d_discardedBytes -= c.d_discardedPages * k_pageSize;
+        d_upstream->deallocate(c.d_memory, chunk_bytes(p), chunk_alignment(p));
+        it = p.d_chunks.erase(it);
+      }
+    }
+    return released;
+  }
+
+  // Release to the kernel the pages whose blocks are all free, in chunks
+  // satisfying 'eligible', until at most 'targetBytes' are retained.
+  template <typename Eligible>
+  std::size_t release_pages(Eligible eligible, std::size_t targetBytes) {
+    std::size_t released = 0;
+#ifdef POOL_RESOURCE_HAVE_MADVISE
+    if (!d_options.release_free_pages)
+      return 0;
+    for (pool &p : d_pools) {
+      if (chunk_bytes(p) < k_pageSize)
+        continue;
+      for (auto &entry : p.d_chunks) {
+        chunk &c = *entry.second;
+        if (!eligible(c))
+          continue;
+        for (std::size_t page = 0; page != c.d_discarded.size(); ++page) {
+          if (retained_bytes() <= targetBytes)
+            return released;
+          if (c.d_discarded[page])
+            continue;
+          const std::size_t first = page * k_pageSize / p.d_blockSize;
+          const std::size_t last =
+              ((page + 1) * k_pageSize - 1) / p.d_blockSize;
+          bool free = true;
+          for (std::size_t index = first; free && index <= last; ++index)
+            free = is_free(c, index);
+          if (!free ||
+              ::madvise(c.d_memory + page * k_pageSize, k_pageSize,
+                        MADV_DONTNEED) != 0)
+            continue;
+          c.d_discarded[page] = true;
+          ++c.d_discardedPages;
+          d_discardedBytes += k_pageSize;
+          released += k_pageSize;
+        }
+      }
+    }
+#endif
+    return released;
+  }
+};
+
+// A 'pool_resource' that may be used from several threads at once and that
+// can scavenge itself periodically on a background thread.
+class synchronized_pool_resource : public pool_resource {
+public:
+  using pool_resource::pool_resource;
+
+  ~synchronized_pool_resource() override { stop_scavenger(); }
+
+  // Call 'scavenge' every 'interval' on a background thread until
+  // 'stop_scavenger' is called or this resource is destroyed.
+  void start_scavenger(std::chrono::steady_clock::duration interval) {
+    stop_scavenger();
+    d_stopScavenger = false;
+    d_scavenger = std::thread([this, interval] {
+      std::unique_lock<std::mutex> lock(d_mutex);
+      while (!d_stopCondition.wait_for(lock, interval,
+                                       [this] { return d_stopScavenger; }))
+        pool_resource::scavenge();
+    });
+  }
+
+  void stop_scavenger() {
+    if (!d_scavenger.joinable())
+      return;
+    {
+      std::lock_guard<std::mutex> lock(d_mutex);
+      d_stopScavenger = true;
+    }
+    d_stopCondition.notify_one();
+    d_scavenger.join();
+  }
+
+  void release() {
+    std::lock_guard<std::mutex> lock(d_mutex);
+    pool_resource::release();
+  }
+
+  std::size_t scavenge() {
+    std::lock_guard<std::mutex> lock(d_mutex);
+    return pool_resource::scavenge();
+  }
+
+  std::size_t trim(std::size_t targetBytes = 0) {
+    std::lock_guard<std::mutex> lock(d_mutex);
+    return pool_resource::trim(targetBytes);
+  }
+
+  std::size_t retained_bytes() const {
+    std::lock_guard<std::mutex> lock(d_mutex);
+    return pool_resource::retained_bytes();
+  }
+
+  std::size_t in_use_bytes() const {
+    std::lock_guard<std::mutex> lock(d_mutex);
+    return pool_resource::in_use_bytes();
+  }
+
+private:
+  mutable std::mutex d_mutex;
+  std::condition_variable d_stopCondition;
+  bool d_stopScavenger = false;
+  std::thread d_scavenger;
+
+  void *do_allocate(size_t bytes, size_t align) override {
+    std::lock_guard<std::mutex> lock(d_mutex);
+    return pool_resource::do_allocate(bytes, align);
+  }
+
+  void do_deallocate(void *ptr, size_t bytes, size_t align) override {
+    std::lock_guard<std::mutex> lock(d_mutex);
+    pool_resource::do_deallocate(ptr, bytes, align);
+  }
+};
+
+#endif
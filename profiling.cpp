@@ -0,0 +1,125 @@
+#include <benchmark.hpp>
+#include <memory_resource.hpp>
+#include <sampling_profiler_resource.hpp>
+#include <simplicity.hpp>
+#include <string.hpp>
+#include <vector.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+// Find out which call sites hold a program's memory with a
+// 'sampling_profiler_resource', and measure what the sampling costs.
+//
+// The program keeps a collection of 'Foo9's alive and churns through
+// short-lived strings. The heap profile should be dominated by the 'Foo9's
+// (their 'Bar9's and the vector holding them) and the allocation profile by
+// the strings. Look at them with
+//
+//     pprof -top ./profiling.gcc heap.pprof
+//     pprof -top ./profiling.gcc alloc.pprof
+
+namespace {
+
+constexpr std::size_t fooCount = 1000000;
+constexpr std::size_t churnCount = 100000;
+constexpr int rounds = 51;
+
+__attribute__((noinline)) void make_foos(std::pmr::vector<Foo9> &foos) {
+  for (std::size_t i = 0; i != fooCount; ++i)
+    foos.emplace_back();
+}
+
+__attribute__((noinline)) std::size_t churn_strings() {
+  std::size_t total = 0;
+  for (std::size_t i = 0; i != churnCount; ++i) {
+    std::pmr::string s("a string long enough to need the heap, number ");
+    s += std::to_string(i);
+    total += s.size();
+  }
+  return total;
+}
+
+// Return the nanoseconds per string of 'churn_strings' allocating from
+// 'resource'.
+double time_churn(std::pmr::memory_resource *resource) {
+  std::pmr::set_default_resource(resource);
+  const auto begin = std::chrono::steady_clock::now();
+  do_not_optimize(churn_strings());
+  const auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - begin).count() /
+         churnCount;
+}
+
+double median(std::vector<double> values) {
+  std::nth_element(values.begin(), values.begin() + values.size() / 2,
+                   values.end());
+  return values[values.size() / 2];
+}
+
+void write_file(const char *name, const std::string &what,
+                void (sampling_profiler_resource::*write)(std::ostream &)
+                    const,
+                const sampling_profiler_resource &profiler) {
+  std::ofstream out(name, std::ios::binary);
+  (profiler.*write)(out);
+  std::cout << "## wrote the " << what << " profile to " << name << std::endl;
+}
+
+} // namespace
+
+int main() {
+  counting_resource counter;
+  sampling_profiler_resource profiler(
+      sampling_profiler_resource::default_sample_interval, &counter);
+
+  // Time the churn with and without the profiler back to back, alternating
+  // which goes first, so that drift in the machine's speed hits both alike.
+  // Report the medians of the times and of the per-round ratios.
+  std::vector<double> unprofiled, profiled, ratios;
+  for (int r = 0; r != rounds; ++r) {
+    double before, after;
+    if (r % 2) {
+      before = time_churn(&counter);
+      after = time_churn(&profiler);
+    } else {
+      after = time_churn(&profiler);
+      before = time_churn(&counter);
+    }
+    unprofiled.push_back(before);
+    profiled.push_back(after);
+    ratios.push_back(after / before);
+  }
+  std::printf("## churn at the default %zu KiB interval, median of %d "
+              "rounds:\n##   unprofiled %.2f ns/op, profiled %.2f ns/op, "
+              "overhead %+.1f%%\n",
+              profiler.sample_interval() / 1024, rounds, median(unprofiled),
+              median(profiled), (median(ratios) - 1) * 100);
+  std::cout << std::endl;
+
+  std::pmr::set_default_resource(&profiler);
+  {
+    std::pmr::vector<Foo9> foos;
+    make_foos(foos);
+
+    const std::size_t actual =
+        foos.capacity() * sizeof(Foo9) + foos.size() * sizeof(Bar9);
+    std::cout << "## " << profiler.live_samples()
+              << " live samples; estimated in-use bytes "
+              << static_cast<std::size_t>(profiler.estimated_in_use_bytes())
+              << ", actual " << actual << std::endl;
+
+    write_file("heap.pprof", "heap",
+               &sampling_profiler_resource::write_heap_profile, profiler);
+    write_file("alloc.pprof", "allocation",
+               &sampling_profiler_resource::write_allocation_profile,
+               profiler);
+  }
+
+  std::pmr::set_default_resource(std::pmr::new_delete_resource());
+}
@@ -0,0 +1,99 @@
+#include <benchmark.hpp>
+#include <memory_resource.hpp>
+#include <rotating_arena_resource.hpp>
+#include <string.hpp>
+#include <vector.hpp>
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+
+// A server loop that allocates each tick's messages from a rotating arena.
+// A few messages are kept for a couple of ticks by pinning their epoch, and
+// one is (deliberately) kept too long. Then epochs that overflow their
+// arena's buffer check that recycling an arena doesn't grow what it asks of
+// the upstream resource.
+
+namespace {
+
+void report(std::uint64_t epoch, std::size_t objects) {
+  std::cout << "  !! " << objects << " object(s) outlived epoch " << epoch
+            << std::endl;
+}
+
+} // namespace
+
+int main() {
+  rotating_arena_resource arenas(4, 64 * 1024);
+  arenas.set_outlived_handler(&report);
+
+  std::cout << "## ticks" << std::endl;
+  std::optional<std::pmr::string> deferred;
+  rotating_arena_resource::epoch_guard deferredGuard;
+  for (int tick = 0; tick != 8; ++tick) {
+    std::pmr::vector<std::pmr::string> messages(&arenas);
+    for (int i = 0; i != 100; ++i)
+      messages.emplace_back("message body that is too long for SSO");
+
+    // Keep one message from tick 2 until tick 4.
+    if (tick == 2) {
+      deferredGuard = arenas.pin();
+      deferred.emplace(messages.front(), &arenas);
+    }
+    if (tick == 4) {
+      std::cout << "  tick 4 still has: " << *deferred << std::endl;
+      deferred.reset();
+      deferredGuard.unpin();
+    }
+
+    std::cout << "  tick " << tick << " ran in epoch " << arenas.epoch()
+              << std::endl;
+    messages.clear();
+    messages.shrink_to_fit();
+    if (!arenas.advance())
+      std::cout << "  epoch " << arenas.epoch() + 1 - arenas.arenas()
+                << " is pinned; staying in epoch " << arenas.epoch()
+                << std::endl;
+  }
+
+  std::cout << "\n## pinned epoch holds back the ring" << std::endl;
+  {
+    rotating_arena_resource::epoch_guard guard = arenas.pin();
+    for (int i = 0; i != 4; ++i)
+      std::cout << "  advance: " << (arenas.advance() ? "ok" : "refused")
+                << std::endl;
+  }
+  std::cout << "  after unpinning: " << (arenas.advance() ? "ok" : "refused")
+            << std::endl;
+
+  std::cout << "\n## epochs that overflow their arena" << std::endl;
+  {
+    counting_resource counter;
+    rotating_arena_resource small(2, 1024, &counter);
+    std::pmr::polymorphic_allocator<std::byte> allocator(&small);
+    const std::size_t setup = counter.bytes_allocated();
+    std::size_t first = 0;
+    for (int tick = 0; tick != 100; ++tick) {
+      const std::size_t before = counter.bytes_allocated();
+      for (int i = 0; i != 8; ++i)
+        allocator.deallocate(allocator.allocate(256), 256);
+      const std::size_t upstream = counter.bytes_allocated() - before;
+      if (tick == 0)
+        first = upstream;
+      assert(upstream == first);
+      small.advance();
+    }
+    std::cout << "  100 ticks of 2 KiB in 1 KiB arenas: " << setup
+              << " bytes up front, then " << first << " bytes per tick"
+              << std::endl;
+  }
+
+  std::cout << "\n## object kept past its arena" << std::endl;
+  std::pmr::polymorphic_allocator<int> allocator(&arenas);
+  int *leaked = allocator.allocate(1);
+  for (std::size_t i = 0; i != arenas.arenas(); ++i)
+    arenas.advance();
+  static_cast<void>(leaked);
+}
@@ -0,0 +1,245 @@
+#ifndef ROTATING_ARENA_RESOURCE_HPP_
+#define ROTATING_ARENA_RESOURCE_HPP_
+
+// A ring of 'monotonic_buffer_resource' arenas, one per epoch, for loops
+// with a natural cadence like a server tick or a frame. Allocation goes to
+// the current epoch's arena and deallocation does nothing. 'advance' starts
+// a new epoch in the oldest arena, releasing everything allocated there, so
+// an object may outlive the epoch it was allocated in by up to 'arenas - 1'
+// further epochs.
+//
+// Each arena starts from a buffer of 'arenaSize' bytes obtained once from
+// the upstream resource. An epoch that fits in it costs no upstream calls,
+// and resetting it is a pointer reset.
+//
+// A reader that needs objects from an epoch to survive can pin it with an
+// 'epoch_guard'; 'advance' then refuses to recycle that arena. Allocation,
+// deallocation, and 'advance' must happen on one thread, but epochs may be
+// pinned and unpinned from any thread.
+//
+// Unless 'NDEBUG' is defined, every allocation is tracked and the outlived
+// handler is told how many objects were still allocated when their arena
+// was reset.
+
+#include <memory_resource.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+#ifndef NDEBUG
+#include <unordered_map>
+#endif
+
+class rotating_arena_resource : public std::pmr::memory_resource {
+  struct slot;
+
+public:
+  // Called, in debug builds, with an epoch and the number of its objects
+  // still allocated when its arena is reset.
+  using outlived_handler = void (*)(std::uint64_t epoch, std::size_t objects);
+
+  // Keep an epoch's arena from being reset while this guard lives. A guard
+  // must not outlive the resource that issued it.
+  class epoch_guard {
+  public:
+    epoch_guard() = default;
+    epoch_guard(epoch_guard &&other) noexcept
+        : d_slot(other.d_slot), d_epoch(other.d_epoch) {
+      other.d_slot = nullptr;
+    }
+    epoch_guard &operator=(epoch_guard &&other) noexcept {
+      if (this != &other) {
+        unpin();
+        d_slot = other.d_slot;
+        d_epoch = other.d_epoch;
+        other.d_slot = nullptr;
+      }
+      return *this;
+    }
+    ~epoch_guard() { unpin(); }
+
+    // Return true if an epoch is pinned.
+    explicit operator bool() const { return d_slot != nullptr; }
+
+    std::uint64_t epoch() const { return d_epoch; }
+
+    void unpin() {
+      if (d_slot)
+        d_slot->d_pins.fetch_sub(1);
+      d_slot = nullptr;
+    }
+
+  private:
+    friend class rotating_arena_resource;
+
+    slot *d_slot = nullptr;
+    std::uint64_t d_epoch = 0;
+
+    epoch_guard(slot *s, std::uint64_t epoch) : d_slot(s), d_epoch(epoch) {}
+  };
+
+  rotating_arena_resource(std::size_t arenas, std::size_t arenaSize,
+                          std::pmr::memory_resource *upstream =
+                              std::pmr::get_default_resource()) {
+    assert(arenas >= 2);
+    d_slots.reserve(arenas);
+    // Slot 'i' starts out holding the (nonexistent) epoch 'i - arenas', so
+    // that only epoch 0 is live.
+    for (std::size_t i = 0; i != arenas; ++i)
+      d_slots.push_back(std::make_unique<slot>(
+          i == 0 ? 0 : std::uint64_t(i) - arenas, arenaSize, upstream));
+  }
+
+  rotating_arena_resource(const rotating_arena_resource &) = delete;
+  rotating_arena_resource &
+  operator=(const rotating_arena_resource &) = delete;
+
+  ~rotating_arena_resource() override {
+    assert(std::none_of(d_slots.begin(), d_slots.end(),
+                        [](const auto &s) { return s->d_pins.load() != 0; }));
+  }
+
+  // Return the epoch new allocations belong to.
+  std::uint64_t epoch() const { return d_epoch.load(); }
+
+  std::size_t arenas() const { return d_slots.size(); }
+
+  // Return true if 'epoch's arena hasn't been reset.
+  bool is_live(std::uint64_t epoch) const {
+    return slot_of(epoch).d_epoch.load() == epoch;
+  }
+
+  // Start a new epoch, resetting the arena of the oldest one. If that epoch
+  // is pinned, do nothing and return false.
+  bool advance() {
+    const std::uint64_t next = d_epoch.load() + 1;
+    slot &s = slot_of(next);
+    const std::uint64_t oldest = s.d_epoch.load();
+    // Claim the slot before checking for pins; a concurrent 'pin' checks
+    // the slot's epoch after announcing itself, so one of us backs off.
+    s.d_epoch.store(next);
+    if (s.d_pins.load() != 0) {
+      s.d_epoch.store(oldest);
+      return false;
+    }
+    reset(s, oldest);
+    d_epoch.store(next);
+    return true;
+  }
+
+  // Pin the current epoch.
+  epoch_guard pin() {
+    for (;;) {
+      epoch_guard guard = pin(epoch());
+      if (guard)
+        return guard;
+    }
+  }
+
+  // Pin 'epoch', returning an empty guard if its arena was already reset or
+  // is being reset concurrently.
+  epoch_guard pin(std::uint64_t epoch) {
+    slot &s = slot_of(epoch);
+    s.d_pins.fetch_add(1);
+    if (s.d_epoch.load() != epoch) {
+      s.d_pins.fetch_sub(1);
+      return epoch_guard();
+    }
+    return epoch_guard(&s, epoch);
+  }
+
+  void set_outlived_handler(outlived_handler handler) { d_outlived = handler; }
+
+private:
+  struct slot {
+    slot(std::uint64_t epoch, std::size_t size,
+         std::pmr::memory_resource *upstream)
+        : d_upstream(upstream), d_size(size),
+          d_buffer(upstream->allocate(size, alignof(std::max_align_t))),
+          d_epoch(epoch) {
+      try {
+        d_arena = std::make_unique<std::pmr::monotonic_buffer_resource>(
+            d_buffer, size, upstream);
+      } catch (...) {
+        upstream->deallocate(d_buffer, size, alignof(std::max_align_t));
+        throw;
+      }
+    }
+
+    ~slot() {
+      d_arena.reset();
+      d_upstream->deallocate(d_buffer, d_size, alignof(std::max_align_t));
+    }
+
+    std::pmr::memory_resource *d_upstream;
+    std::size_t d_size;
+    void *d_buffer;
+    std::unique_ptr<std::pmr::monotonic_buffer_resource> d_arena;
+    std::atomic<std::uint64_t> d_epoch;
+    std::atomic<std::size_t> d_pins{0};
+#ifndef NDEBUG
+    std::size_t d_live = 0;
+#endif
+  };
+
+  std::vector<std::unique_ptr<slot>> d_slots;
+  std::atomic<std::uint64_t> d_epoch{0};
+  outlived_handler d_outlived = &report_outlived;
+#ifndef NDEBUG
+  std::unordered_map<void *, slot *> d_owners;
+#endif
+
+  static void report_outlived(std::uint64_t epoch, std::size_t objects) {
+    std::cerr << "rotating_arena_resource: " << objects
+              << " object(s) outlived epoch " << epoch << std::endl;
+  }
+
+  slot &slot_of(std::uint64_t epoch) const {
+    return *d_slots[epoch % d_slots.size()];
+  }
+
+  void reset(slot &s, std::uint64_t oldEpoch) {
+#ifndef NDEBUG
+    if (s.d_live != 0) {
+      for (auto it = d_owners.begin(); it != d_owners.end();)
+        it = it->second == &s ? d_owners.erase(it) : std::next(it);
+      d_outlived(oldEpoch, s.d_live);
+      s.d_live = 0;
+    }
+#endif
+    s.d_arena->release();
+  }
+
+  void *do_allocate(size_t bytes, size_t align) override {
+    slot &s = slot_of(epoch());
+    void *const p = s.d_arena->allocate(bytes, align);
+#ifndef NDEBUG
+    d_owners[p] = &s;
+    ++s.d_live;
+#endif
+    return p;
+  }
+
+  void do_deallocate(void *p, size_t bytes, size_t align) override {
+#ifndef NDEBUG
+    const auto it = d_owners.find(p);
+    if (it != d_owners.end()) {
+      --it->second->d_live;
+      d_owners.erase(it);
+    }
+#endif
+  }
+
+  bool do_is_equal(memory_resource const &other) const noexcept override {
+    return this == &other;
+  }
+};
+
+#endif
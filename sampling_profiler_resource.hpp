@@ -0,0 +1,400 @@
+#ifndef SAMPLING_PROFILER_RESOURCE_HPP_
+#define SAMPLING_PROFILER_RESOURCE_HPP_
+
+// A resource that attributes memory to call sites by sampling, cheaply
+// enough to leave on in production. Instead of recording every allocation
+// it records one about every 'sampleInterval' bytes: the distance to the
+// next sample is drawn from an exponential distribution, so each allocated
+// byte is equally likely to be sampled and large allocations are sampled
+// more often than small ones. A sampled allocation gets a backtrace and is
+// tracked until it is deallocated; its statistics are scaled by the inverse
+// of its sampling probability to estimate the true totals.
+//
+// Each thread counts down its own distance to the next sample, so an
+// unsampled allocation costs a subtraction from a thread-local counter and
+// its deallocation one relaxed load from a small filter of sampled
+// addresses. A thread switching between profilers just draws a fresh
+// distance; the exponential distribution has no memory, so that doesn't
+// bias the samples.
+//
+// That is not free. In 'profiling.cpp', a loop that does little but
+// allocate two strings per iteration at about 100 ns an iteration, the
+// default interval adds 7-11%: about 3% for an extra resource in the chain,
+// as any wrapper costs, a few percent for the countdown and filter, and 1-2%
+// for the backtraces. The overhead stays under 1% only in programs that
+// spend no more than about a tenth of their time allocating.
+//
+// Profiles are written in pprof's protocol buffer format, uncompressed,
+// with the process's executable mappings so that 'pprof' can symbolize them
+// from the binaries:
+//
+//     pprof -top ./program heap.pprof
+
+#include <memory_resource.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if __has_include(<execinfo.h>)
+#include <execinfo.h>
+#define SAMPLING_PROFILER_HAVE_BACKTRACE 1
+#endif
+
+class sampling_profiler_resource : public std::pmr::memory_resource {
+public:
+  static constexpr std::size_t default_sample_interval = 512 * 1024;
+
+  explicit sampling_profiler_resource(
+      std::size_t sampleInterval = default_sample_interval,
+      std::pmr::memory_resource *upstream = std::pmr::get_default_resource(),
+      std::uint64_t seed = std::random_device{}())
+      : d_upstream(upstream), d_sampleInterval(sampleInterval),
+        d_seed(seed) {}
+
+  sampling_profiler_resource(const sampling_profiler_resource &) = delete;
+  sampling_profiler_resource &
+  operator=(const sampling_profiler_resource &) = delete;
+
+  // Write the estimated objects and bytes currently allocated, by call
+  // site.
+  void write_heap_profile(std::ostream &out) const {
+    write_profile(out, "inuse", [](const stack_stats &s) {
+      return std::array<double, 2>{s.d_inUseObjects, s.d_inUseBytes};
+    });
+  }
+
+  // Write the estimated objects and bytes allocated since construction, by
+  // call site.
+  void write_allocation_profile(std::ostream &out) const {
+    write_profile(out, "alloc", [](const stack_stats &s) {
+      return std::array<double, 2>{s.d_allocObjects, s.d_allocBytes};
+    });
+  }
+
+  // Return the estimated bytes currently allocated.
+  double estimated_in_use_bytes() const {
+    std::lock_guard<std::mutex> lock(d_mutex);
+    double result = 0;
+    for (const stack_stats &s : d_stacks)
+      result += s.d_inUseBytes;
+    return result;
+  }
+
+  // Return the number of sampled allocations not yet deallocated.
+  std::size_t live_samples() const {
+    std::lock_guard<std::mutex> lock(d_mutex);
+    return d_live.size();
+  }
+
+  std::size_t sample_interval() const { return d_sampleInterval; }
+
+  std::pmr::memory_resource *upstream_resource() const { return d_upstream; }
+
+private:
+  static constexpr int k_maxFrames = 64;
+  static constexpr std::size_t k_filterSize = 4096;
+
+  // The countdown of the profiler a thread last allocated from.
+  struct thread_state {
+    const sampling_profiler_resource *d_owner = nullptr;
+    std::int64_t d_untilSample = 0;
+    std::uint64_t d_random = 0;
+  };
+
+  struct stack_stats {
+    double d_allocObjects = 0;
+    double d_allocBytes = 0;
+    double d_inUseObjects = 0;
+    double d_inUseBytes = 0;
+  };
+
+  struct live_sample {
+    std::size_t d_stack;
+    double d_objects; // the scaled estimates this sample stands for
+    double d_bytes;
+  };
+
+  std::pmr::memory_resource *d_upstream;
+  const std::size_t d_sampleInterval;
+  const std::uint64_t d_seed;
+  std::atomic<std::uint64_t> d_threads{0};
+  std::array<std::atomic<std::uint32_t>, k_filterSize> d_filter{};
+
+  mutable std::mutex d_mutex;
+  std::map<std::vector<void *>, std::size_t> d_stackIds;
+  std::vector<const std::vector<void *> *> d_stackFrames; // by id
+  std::vector<stack_stats> d_stacks;                       // by id
+  std::unordered_map<void *, live_sample> d_live;
+
+  static thread_state &local() {
+    static thread_local thread_state state;
+    return state;
+  }
+
+  // Return the next value of the 'splitmix64' generator in 'state'.
+  static std::uint64_t next_random(std::uint64_t &state) {
+    std::uint64_t z = state += 0x9e3779b97f4a7c15;
+    z = (z ^ z >> 30) * 0xbf58476d1ce4e5b9;
+    z = (z ^ z >> 27) * 0x94d049bb133111eb;
+    return z ^ z >> 31;
+  }
+
+  // Return a distance to the next sample, exponentially distributed with a
+  // mean of 'd_sampleInterval' bytes.
+  std::int64_t next_interval(thread_state &t) const {
+    const double u = ((next_random(t.d_random) >> 11) + 1) * 0x1.0p-53;
+    return static_cast<std::int64_t>(-std::log(u) * d_sampleInterval) + 1;
+  }
+
+  static std::size_t filter_index(void *p) {
+    const auto bits = reinterpret_cast<std::uintptr_t>(p);
+    return (bits >> 4 ^ bits >> 16) % k_filterSize;
+  }
+
+  // Record 'p' as a sample of 'bytes', with the stack from the frame that
+  // returns to 'caller' outward.
+  void sample(void *p, std::size_t bytes, void *caller) {
+    void *frames[k_maxFrames];
+    int depth = 0;
+#ifdef SAMPLING_PROFILER_HAVE_BACKTRACE
+    depth = ::backtrace(frames, k_maxFrames);
+#endif
+    void **const first = std::find(frames, frames + depth, caller);
+    std::vector<void *> stack(first, frames + depth);
+
+    // The probability that an allocation of 'bytes' contains a sample.
+    const double probability =
+        1 - std::exp(-static_cast<double>(bytes) / d_sampleInterval);
+    const double objects = 1 / probability;
+
+    std::lock_guard<std::mutex> lock(d_mutex);
+    auto inserted = d_stackIds.emplace(std::move(stack), d_stacks.size());
+    if (inserted.second) {
+      d_stackFrames.push_back(&inserted.first->first);
+      d_stacks.emplace_back();
+    }
+    const std::size_t id = inserted.first->second;
+    stack_stats &stats = d_stacks[id];
+    stats.d_allocObjects += objects;
+    stats.d_allocBytes += objects * bytes;
+    stats.d_inUseObjects += objects;
+    stats.d_inUseBytes += objects * bytes;
+    d_live[p] = live_sample{id, objects, objects * bytes};
+    d_filter[filter_index(p)].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // The common cases of 'do_allocate' and 'do_deallocate' are kept small
+  // enough to end in a tail call upstream; everything else is out of line.
+  void *do_allocate(size_t bytes, size_t align) override {
+    thread_state &t = local();
+    t.d_untilSample -= static_cast<std::int64_t>(bytes);
+    if (__builtin_expect(t.d_owner == this && t.d_untilSample > 0, 1))
+      return d_upstream->allocate(bytes, align);
+    return allocate_slow(bytes, align, __builtin_return_address(0));
+  }
+
+  __attribute__((noinline)) void *allocate_slow(size_t bytes, size_t align,
+                                                void *caller) {
+    void *const p = d_upstream->allocate(bytes, align);
+    thread_state &t = local();
+    if (t.d_owner != this) {
+      t.d_owner = this;
+      t.d_random = next_random(t.d_random) ^ d_seed ^
+                   d_threads.fetch_add(1, std::memory_order_relaxed);
+      t.d_untilSample =
+          next_interval(t) - static_cast<std::int64_t>(bytes);
+      if (t.d_untilSample > 0)
+        return p;
+    }
+    t.d_untilSample = next_interval(t);
+    try {
+      sample(p, bytes, caller);
+    } catch (...) {
+      // Losing a sample is better than failing the allocation.
+    }
+    return p;
+  }
+
+  void do_deallocate(void *p, size_t bytes, size_t align) override {
+    if (__builtin_expect(
+            d_filter[filter_index(p)].load(std::memory_order_relaxed) != 0, 0))
+      return deallocate_slow(p, bytes, align);
+    d_upstream->deallocate(p, bytes, align);
+  }
+
+  // Stop tracking 'p' if it was sampled, then deallocate it.
+  __attribute__((noinline)) void deallocate_slow(void *p, size_t bytes,
+                                                 size_t align) {
+    {
+      std::lock_guard<std::mutex> lock(d_mutex);
+      const auto it = d_live.find(p);
+      if (it != d_live.end()) {
+        stack_stats &stats = d_stacks[it->second.d_stack];
+        stats.d_inUseObjects -= it->second.d_objects;
+        stats.d_inUseBytes -= it->second.d_bytes;
+        d_live.erase(it);
+        d_filter[filter_index(p)].fetch_sub(1, std::memory_order_relaxed);
+      }
+    }
+    d_upstream->deallocate(p, bytes, align);
+  }
+
+  bool do_is_equal(memory_resource const &other) const noexcept override {
+    return this == &other;
+  }
+
+  // A minimal encoder for the messages of pprof's 'profile.proto'.
+  class proto_writer {
+  public:
+    void varint(int field, std::uint64_t value) {
+      key(field, 0);
+      raw_varint(value);
+    }
+    void bytes(int field, const std::string &value) {
+      key(field, 2);
+      raw_varint(value.size());
+      d_data += value;
+    }
+    void packed(int field, const std::vector<std::uint64_t> &values) {
+      proto_writer body;
+      for (std::uint64_t value : values)
+        body.raw_varint(value);
+      bytes(field, body.d_data);
+    }
+    const std::string &data() const { return d_data; }
+
+  private:
+    std::string d_data;
+
+    void key(int field, int wireType) {
+      raw_varint(static_cast<std::uint64_t>(field) << 3 | wireType);
+    }
+    void raw_varint(std::uint64_t value) {
+      while (value >= 0x80) {
+        d_data += static_cast<char>(value | 0x80);
+        value >>= 7;
+      }
+      d_data += static_cast<char>(value);
+    }
+  };
+
+  struct mapping {
+    std::uint64_t d_start;
+    std::uint64_t d_limit;
+    std::uint64_t d_offset;
+    std::string d_file;
+  };
+
+  // Return the executable mappings of this process.
+  static std::vector<mapping> read_mappings() {
+    std::vector<mapping> result;
+    std::ifstream maps("/proc/self/maps");
+    std::string line;
+    while (std::getline(maps, line)) {
+      std::istringstream fields(line);
+      std::string range, permissions, offset, device, inode, file;
+      fields >> range >> permissions >> offset >> device >> inode >> file;
+      if (permissions.size() < 3 || permissions[2] != 'x' || file.empty())
+        continue;
+      const std::size_t dash = range.find('-');
+      result.push_back({std::stoull(range.substr(0, dash), nullptr, 16),
+                        std::stoull(range.substr(dash + 1), nullptr, 16),
+                        std::stoull(offset, nullptr, 16), file});
+    }
+    return result;
+  }
+
+  template <typename Values>
+  void write_profile(std::ostream &out, const std::string &prefix,
+                     Values values) const {
+    std::vector<std::string> strings{""};
+    std::unordered_map<std::string, std::uint64_t> stringIds{{"", 0}};
+    const auto string_id = [&](const std::string &s) {
+      const auto inserted = stringIds.emplace(s, strings.size());
+      if (inserted.second)
+        strings.push_back(s);
+      return inserted.first->second;
+    };
+    const auto value_type = [&](const std::string &type,
+                                const std::string &unit) {
+      proto_writer vt;
+      vt.varint(1, string_id(type));
+      vt.varint(2, string_id(unit));
+      return vt.data();
+    };
+
+    proto_writer profile;
+    profile.bytes(1, value_type(prefix + "_objects", "count"));
+    profile.bytes(1, value_type(prefix + "_space", "bytes"));
+
+    const std::vector<mapping> mappings = read_mappings();
+    for (std::size_t i = 0; i != mappings.size(); ++i) {
+      proto_writer m;
+      m.varint(1, i + 1);
+      m.varint(2, mappings[i].d_start);
+      m.varint(3, mappings[i].d_limit);
+      m.varint(4, mappings[i].d_offset);
+      m.varint(5, string_id(mappings[i].d_file));
+      profile.bytes(3, m.data());
+    }
+
+    std::lock_guard<std::mutex> lock(d_mutex);
+    std::map<std::uint64_t, std::uint64_t> locationIds; // by address
+    for (std::size_t id = 0; id != d_stacks.size(); ++id) {
+      const std::array<double, 2> v = values(d_stacks[id]);
+      if (v[0] < 0.5 && v[1] < 0.5)
+        continue;
+      std::vector<std::uint64_t> locations;
+      const std::vector<void *> &frames = *d_stackFrames[id];
+      for (void *frame : frames) {
+        // Every frame kept is a return address, which points after its call;
+        // attribute the call itself.
+        const std::uint64_t address =
+            reinterpret_cast<std::uintptr_t>(frame) - 1;
+        const auto inserted =
+            locationIds.emplace(address, locationIds.size() + 1);
+        locations.push_back(inserted.first->second);
+      }
+      proto_writer sample;
+      sample.packed(1, locations);
+      sample.packed(2, {static_cast<std::uint64_t>(std::llround(v[0])),
+                        static_cast<std::uint64_t>(std::llround(v[1]))});
+      profile.bytes(2, sample.data());
+    }
+
+    for (const auto &[address, id] : locationIds) {
+      proto_writer location;
+      location.varint(1, id);
+      for (std::size_t i = 0; i != mappings.size(); ++i) {
+        if (mappings[i].d_start <= address && address < mappings[i].d_limit) {
+          location.varint(2, i + 1);
+          break;
+        }
+      }
+      location.varint(3, address);
+      profile.bytes(4, location.data());
+    }
+
+    profile.bytes(11, value_type("space", "bytes"));
+    profile.varint(12, d_sampleInterval);
+    for (const std::string &s : strings)
+      profile.bytes(6, s);
+
+    out.write(profile.data().data(), profile.data().size());
+  }
+};
+
+#endif
@@ -0,0 +1,72 @@
+#include <memory_resource.hpp>
+#include <pool_resource.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Show a pool giving memory back after a burst: first explicitly with
+// 'trim', then on its own with a background scavenger.
+
+namespace {
+
+constexpr std::size_t blockSize = 64;
+constexpr std::size_t burstBlocks = 100000;
+
+void print_usage(const char *when, const synchronized_pool_resource &pool) {
+  std::cout << "  " << when << ": retained " << pool.retained_bytes()
+            << " bytes, in use " << pool.in_use_bytes() << " bytes"
+            << std::endl;
+}
+
+// Allocate a burst of blocks and free all of them but every 'keepEvery'th.
+std::vector<void *> burst(std::pmr::memory_resource &resource,
+                          std::size_t keepEvery) {
+  std::vector<void *> blocks;
+  for (std::size_t i = 0; i != burstBlocks; ++i)
+    blocks.push_back(resource.allocate(blockSize));
+  std::vector<void *> kept;
+  for (std::size_t i = 0; i != blocks.size(); ++i) {
+    if (i % keepEvery == 0)
+      kept.push_back(blocks[i]);
+    else
+      resource.deallocate(blocks[i], blockSize);
+  }
+  return kept;
+}
+
+void free_all(std::pmr::memory_resource &resource,
+              const std::vector<void *> &blocks) {
+  for (void *block : blocks)
+    resource.deallocate(block, blockSize);
+}
+
+} // namespace
+
+int main() {
+  pool_options options;
+  options.decay = std::chrono::milliseconds(200);
+  options.release_free_pages = true; // the upstream is 'new_delete_resource'
+  synchronized_pool_resource pool(options, std::pmr::new_delete_resource());
+
+  std::cout << "## trim" << std::endl;
+  std::vector<void *> kept = burst(pool, 1000);
+  print_usage("after burst", pool);
+  std::cout << "  trimmed " << pool.trim() << " bytes" << std::endl;
+  print_usage("after trim", pool);
+  free_all(pool, kept);
+  std::cout << "  trimmed " << pool.trim() << " bytes" << std::endl;
+  print_usage("after freeing the rest and trimming", pool);
+
+  std::cout << "\n## background scavenger" << std::endl;
+  pool.start_scavenger(std::chrono::milliseconds(50));
+  kept = burst(pool, burstBlocks);
+  print_usage("after burst", pool);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  print_usage("before decay", pool);
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  print_usage("after decay", pool);
+  free_all(pool, kept);
+}
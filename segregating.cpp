@@ -0,0 +1,92 @@
+#include <benchmark.hpp>
+#include <memory_resource.hpp>
+#include <pool_resource.hpp>
+#include <segregating_resource.hpp>
+#include <string.hpp>
+#include <vector.hpp>
+
+#include <cstddef>
+#include <iostream>
+#include <sstream>
+
+// Let a 'segregating_resource' learn a policy from a workload mixing
+// short-lived strings, growing vectors, and large buffers; then freeze it,
+// export it, and run the workload again under the imported policy. Then run
+// it a few more times while one long-lived table keeps the arena from being
+// released, and show that the arena's budget keeps the memory held from
+// upstream flat.
+
+namespace {
+
+void workload(std::pmr::memory_resource *resource) {
+  std::pmr::polymorphic_allocator<std::byte> allocator{resource};
+
+  // Long-lived tables that only grow.
+  std::pmr::vector<std::pmr::vector<int>> tables(allocator);
+  for (int t = 0; t != 100; ++t) {
+    tables.emplace_back();
+    for (int i = 0; i != 10000; ++i)
+      tables.back().push_back(i);
+  }
+
+  // Short-lived keys, as a 'Bar9' holds, too long for the small string
+  // optimization.
+  for (int i = 0; i != 100000; ++i) {
+    std::pmr::string key("data data data data data data data", allocator);
+    key += static_cast<char>('a' + i % 26);
+  }
+
+  // Occasional large scratch buffers.
+  for (int i = 0; i != 16; ++i)
+    std::pmr::vector<char> scratch(4 * 1024 * 1024, allocator);
+}
+
+void print_routes(const segregating_resource &resource) {
+  for (segregating_route route :
+       {segregating_route::pool, segregating_route::arena,
+        segregating_route::upstream})
+    std::cout << "  " << segregating_route_name(route) << ": "
+              << resource.routed(route) << " allocations" << std::endl;
+}
+
+} // namespace
+
+int main() {
+  counting_resource upstream;
+  pool_resource pool(&upstream);
+
+  std::cout << "## learning" << std::endl;
+  std::pmr::monotonic_buffer_resource learnerArena(&upstream);
+  segregating_resource learner(&pool, &learnerArena, &upstream);
+  workload(&learner);
+  learner.freeze();
+  print_routes(learner);
+
+  std::stringstream exported;
+  exported << learner.policy();
+  std::cout << "\n## exported policy\n" << exported.str();
+
+  segregating_policy policy;
+  exported >> policy;
+
+  std::cout << "\n## frozen" << std::endl;
+  std::pmr::monotonic_buffer_resource arena(&upstream);
+  segregating_resource frozen(&pool, &arena, &upstream, policy);
+  workload(&frozen);
+  print_routes(frozen);
+
+  std::cout << "\n## frozen, repeated, with a table kept throughout"
+            << std::endl;
+  {
+    std::pmr::vector<int> kept(10000, 0, &frozen);
+    for (int round = 0; round != 5; ++round) {
+      workload(&frozen);
+      std::cout << "  round " << round << ": arena served "
+                << frozen.arena_bytes() << " bytes; upstream holds "
+                << upstream.bytes_in_use() << " bytes" << std::endl;
+    }
+  }
+
+  std::cout << "\n## upstream saw " << upstream.allocations()
+            << " allocations" << std::endl;
+}
@@ -0,0 +1,354 @@
+#ifndef SEGREGATING_RESOURCE_HPP_
+#define SEGREGATING_RESOURCE_HPP_
+
+// A resource that routes each request to one of three resources -- a pool
+// for small blocks, a monotonic arena, and a general-purpose upstream -- by
+// size class. Which size class goes where is learned at run time from
+// per-class histograms of allocation counts and lifetimes:
+//
+// - Small classes whose blocks tend to die young (short-lived strings, for
+//   example) go to the pool, where they are recycled.
+// - Classes whose blocks live long, or die only because a larger block
+//   replaced them (the buffers of a growing vector), go to the arena, where
+//   allocation is a pointer bump.
+// - Everything else, and anything larger than 'arena_limit', goes upstream.
+//
+// The arena never reuses a freed block, so its tier is bounded two ways:
+// once every block routed to it has been freed the arena is released, and
+// once 'arena_budget' bytes have gone to it since its last release, further
+// arena requests are served upstream instead. The arena must serve only
+// this resource.
+//
+// Lifetimes are measured in allocations made through this resource, not in
+// wall-clock time. Once the policy looks right it can be frozen, which stops
+// the bookkeeping, and exported to seed other instances.
+
+#include <memory_resource.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+enum class segregating_route : unsigned char { pool, arena, upstream };
+
+inline const char *segregating_route_name(segregating_route route) {
+  switch (route) {
+  case segregating_route::pool:
+    return "pool";
+  case segregating_route::arena:
+    return "arena";
+  case segregating_route::upstream:
+    return "upstream";
+  }
+  return "?";
+}
+
+// The route of every power-of-two size class. Class 'i' holds requests of
+// more than '2^(i-1)' and at most '2^i' bytes; the last class holds
+// everything larger. A default policy sends everything upstream.
+struct segregating_policy {
+  static constexpr std::size_t size_classes = 32;
+
+  std::array<segregating_route, size_classes> routes = uniform_routes();
+
+  static std::array<segregating_route, size_classes> uniform_routes(
+      segregating_route route = segregating_route::upstream) {
+    std::array<segregating_route, size_classes> result;
+    result.fill(route);
+    return result;
+  }
+
+  static std::size_t size_class(std::size_t bytes) {
+    std::size_t result = 0;
+    while (result + 1 < size_classes && (std::size_t(1) << result) < bytes)
+      ++result;
+    return result;
+  }
+
+  static std::size_t class_limit(std::size_t sizeClass) {
+    return std::size_t(1) << sizeClass;
+  }
+
+  segregating_route route(std::size_t bytes) const {
+    return routes[size_class(bytes)];
+  }
+
+  // Write one "<largest size> <route>" line per run of classes sharing a
+  // route, which is also the format 'operator>>' reads.
+  friend std::ostream &operator<<(std::ostream &out,
+                                  const segregating_policy &policy) {
+    for (std::size_t i = 0; i != size_classes; ++i) {
+      if (i + 1 != size_classes && policy.routes[i] == policy.routes[i + 1])
+        continue;
+      if (i + 1 == size_classes)
+        out << "* ";
+      else
+        out << class_limit(i) << ' ';
+      out << segregating_route_name(policy.routes[i]) << '\n';
+    }
+    return out;
+  }
+
+  friend std::istream &operator>>(std::istream &in,
+                                  segregating_policy &policy) {
+    segregating_policy result = policy;
+    std::size_t next = 0;
+    std::string limit, name;
+    while (next != size_classes && in >> limit >> name) {
+      segregating_route route;
+      if (name == "pool")
+        route = segregating_route::pool;
+      else if (name == "arena")
+        route = segregating_route::arena;
+      else if (name == "upstream")
+        route = segregating_route::upstream;
+      else {
+        in.setstate(std::ios::failbit);
+        return in;
+      }
+      const std::size_t last =
+          limit == "*" ? size_classes - 1 : size_class(std::stoull(limit));
+      while (next <= last)
+        result.routes[next++] = route;
+    }
+    if (next == size_classes)
+      policy = result;
+    else
+      in.setstate(std::ios::failbit);
+    return in;
+  }
+};
+
+struct segregating_options {
+  // The largest request the pool is offered.
+  std::size_t pool_limit = 512;
+  // The largest request the arena is offered.
+  std::size_t arena_limit = 1024 * 1024;
+  // The bytes the arena may serve between two of its releases.
+  std::size_t arena_budget = 8 * 1024 * 1024;
+  // A block freed within this many allocations of its birth is short-lived.
+  std::size_t lifetime_window = 1024;
+  // The allocations a class needs before its route is learned.
+  std::size_t min_samples = 64;
+  // The policy is recomputed after this many allocations.
+  std::size_t relearn_interval = 4096;
+  // The fraction of short-lived blocks above which a class "churns".
+  double churn_threshold = 0.5;
+};
+
+class segregating_resource : public std::pmr::memory_resource {
+public:
+  // Create a resource that learns its policy, starting from "pool up to
+  // 'pool_limit', upstream beyond".
+  segregating_resource(std::pmr::memory_resource *pool,
+                       std::pmr::monotonic_buffer_resource *arena,
+                       std::pmr::memory_resource *upstream,
+                       const segregating_options &options = {})
+      : d_pool(pool), d_arena(arena), d_upstream(upstream),
+        d_options(options) {
+    for (std::size_t i = 0; i != segregating_policy::size_classes; ++i)
+      d_policy.routes[i] = i <= segregating_policy::size_class(
+                                    d_options.pool_limit)
+                               ? segregating_route::pool
+                               : segregating_route::upstream;
+  }
+
+  // Create a frozen resource that follows 'policy'.
+  segregating_resource(std::pmr::memory_resource *pool,
+                       std::pmr::monotonic_buffer_resource *arena,
+                       std::pmr::memory_resource *upstream,
+                       const segregating_policy &policy,
+                       const segregating_options &options = {})
+      : d_pool(pool), d_arena(arena), d_upstream(upstream),
+        d_options(options), d_policy(policy), d_frozen(true) {}
+
+  segregating_resource(const segregating_resource &) = delete;
+  segregating_resource &operator=(const segregating_resource &) = delete;
+
+  // Stop learning. The current policy is used from now on.
+  void freeze() {
+    if (!d_frozen)
+      relearn();
+    d_frozen = true;
+  }
+
+  bool frozen() const { return d_frozen; }
+
+  // Return the policy currently in use.
+  const segregating_policy &policy() const { return d_policy; }
+
+  // Return the number of requests each route has served. Arena requests
+  // over the budget count as upstream.
+  std::size_t routed(segregating_route route) const {
+    return d_routed[static_cast<std::size_t>(route)];
+  }
+
+  // Return the bytes the arena has served since its last release.
+  std::size_t arena_bytes() const { return d_arenaBytes; }
+
+private:
+  struct class_stats {
+    std::uint64_t allocations = 0;
+    std::uint64_t shortLived = 0; // freed within the lifetime window
+    std::uint64_t replaced = 0;   // freed right after a larger allocation
+  };
+
+  struct live_block {
+    std::uint64_t birth;
+    segregating_route route;
+  };
+
+  std::pmr::memory_resource *d_pool;
+  std::pmr::monotonic_buffer_resource *d_arena;
+  std::pmr::memory_resource *d_upstream;
+  segregating_options d_options;
+  segregating_policy d_policy;
+  bool d_frozen = false;
+  std::array<std::size_t, 3> d_routed{};
+
+  // Arena state. Once frozen, 'd_spilled' remembers the blocks of arena
+  // classes that went upstream because the budget was spent.
+  std::size_t d_arenaBytes = 0;
+  std::size_t d_arenaLive = 0;
+  std::unordered_set<void *> d_spilled;
+
+  // Learning state. 'd_live' also remembers the route of every block
+  // allocated while learning, since the policy may change before it's freed.
+  std::array<class_stats, segregating_policy::size_classes> d_stats{};
+  std::unordered_map<void *, live_block> d_live;
+  std::uint64_t d_clock = 0;
+  std::size_t d_lastBytes = 0;  // size of the latest allocation
+  bool d_justAllocated = false; // no deallocation since then
+
+  std::pmr::memory_resource *resource(segregating_route route) const {
+    switch (route) {
+    case segregating_route::pool:
+      return d_pool;
+    case segregating_route::arena:
+      return d_arena;
+    case segregating_route::upstream:
+      break;
+    }
+    return d_upstream;
+  }
+
+  // Allocate from the resource of 'route', or from upstream if 'route' is
+  // the arena and its budget is spent, and set 'route' to where the block
+  // came from.
+  void *allocate_routed(segregating_route &route, size_t bytes,
+                        size_t align) {
+    if (route == segregating_route::arena) {
+      if (d_arenaBytes + bytes > d_options.arena_budget)
+        route = segregating_route::upstream;
+      else {
+        void *const p = d_arena->allocate(bytes, align);
+        d_arenaBytes += bytes;
+        ++d_arenaLive;
+        return p;
+      }
+    }
+    return resource(route)->allocate(bytes, align);
+  }
+
+  // Return a block to the resource of 'route', releasing the arena when its
+  // last block is freed.
+  void deallocate_routed(segregating_route route, void *p, size_t bytes,
+                         size_t align) {
+    resource(route)->deallocate(p, bytes, align);
+    if (route == segregating_route::arena && --d_arenaLive == 0) {
+      d_arena->release();
+      d_arenaBytes = 0;
+    }
+  }
+
+  void relearn() {
+    const std::size_t poolClass =
+        segregating_policy::size_class(d_options.pool_limit);
+    const std::size_t arenaClass =
+        segregating_policy::size_class(d_options.arena_limit);
+    for (std::size_t i = 0; i != segregating_policy::size_classes; ++i) {
+      const class_stats &stats = d_stats[i];
+      if (i > arenaClass) {
+        d_policy.routes[i] = segregating_route::upstream;
+        continue;
+      }
+      if (stats.allocations < d_options.min_samples)
+        continue;
+      const double churn =
+          static_cast<double>(stats.shortLived) / stats.allocations;
+      const double waste =
+          static_cast<double>(stats.shortLived - stats.replaced) /
+          stats.allocations;
+      if (i <= poolClass && churn >= d_options.churn_threshold)
+        d_policy.routes[i] = segregating_route::pool;
+      else if (waste < d_options.churn_threshold)
+        d_policy.routes[i] = segregating_route::arena;
+      else
+        d_policy.routes[i] = segregating_route::upstream;
+    }
+  }
+
+  void *do_allocate(size_t bytes, size_t align) override {
+    const segregating_route wanted = d_policy.route(bytes);
+    segregating_route route = wanted;
+    void *const p = allocate_routed(route, bytes, align);
+    try {
+      if (d_frozen && route != wanted)
+        d_spilled.insert(p);
+      else if (!d_frozen)
+        d_live.emplace(p, live_block{d_clock, route});
+    } catch (...) {
+      deallocate_routed(route, p, bytes, align);
+      throw;
+    }
+    if (d_frozen) {
+      ++d_routed[static_cast<std::size_t>(route)];
+      return p;
+    }
+
+    ++d_routed[static_cast<std::size_t>(route)];
+    ++d_stats[segregating_policy::size_class(bytes)].allocations;
+    d_lastBytes = bytes;
+    d_justAllocated = true;
+    if (++d_clock % d_options.relearn_interval == 0)
+      relearn();
+    return p;
+  }
+
+  void do_deallocate(void *p, size_t bytes, size_t align) override {
+    // Blocks allocated while learning are looked up even once frozen.
+    if (!d_live.empty()) {
+      const auto it = d_live.find(p);
+      if (it != d_live.end()) {
+        const live_block block = it->second;
+        d_live.erase(it);
+        if (!d_frozen) {
+          class_stats &stats = d_stats[segregating_policy::size_class(bytes)];
+          if (d_clock - block.birth <= d_options.lifetime_window)
+            ++stats.shortLived;
+          if (d_clock - block.birth <= d_options.lifetime_window &&
+              d_justAllocated && d_lastBytes > bytes)
+            ++stats.replaced;
+          d_justAllocated = false;
+        }
+        return deallocate_routed(block.route, p, bytes, align);
+      }
+    }
+    segregating_route route = d_policy.route(bytes);
+    if (route == segregating_route::arena && !d_spilled.empty() &&
+        d_spilled.erase(p))
+      route = segregating_route::upstream;
+    deallocate_routed(route, p, bytes, align);
+  }
+
+  bool do_is_equal(memory_resource const &other) const noexcept override {
+    return this == &other;
+  }
+};
+
+#endif
@@ -0,0 +1,301 @@
+#ifndef SMALL_VECTOR_HPP_
+#define SMALL_VECTOR_HPP_
+
+// A vector that keeps up to 'N' elements inline and only allocates from its
+// polymorphic allocator beyond that. It follows the allocator rules of
+// 'std::pmr::vector': the allocator is fixed at construction, copies take a
+// new (or the default) allocator, plain moves keep the source's allocator,
+// and allocator-extended moves only steal storage when the allocators
+// compare equal.
+//
+// Unlike 'std::pmr::vector', moving an inline 'small_vector' moves its
+// elements one by one, so the plain move constructor is 'noexcept' only when
+// 'T's is.
+
+#include <memory_resource.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace pmr {
+
+template <typename T, std::size_t N> class small_vector {
+public:
+  using value_type = T;
+  using allocator_type = std::pmr::polymorphic_allocator<T>;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using reference = T &;
+  using const_reference = const T &;
+  using pointer = T *;
+  using const_pointer = const T *;
+  using iterator = T *;
+  using const_iterator = const T *;
+
+  small_vector(allocator_type allocator = {}) : d_allocator(allocator) {}
+
+  small_vector(size_type count, const T &value, allocator_type allocator = {})
+      : small_vector(allocator) {
+    assign(count, value);
+  }
+
+  small_vector(std::initializer_list<T> values, allocator_type allocator = {})
+      : small_vector(allocator) {
+    assign(values.begin(), values.end());
+  }
+
+  small_vector(const small_vector &other, allocator_type allocator = {})
+      : small_vector(allocator) {
+    assign(other.begin(), other.end());
+  }
+
+  small_vector(small_vector &&other) noexcept(
+      std::is_nothrow_move_constructible_v<T>)
+      : d_allocator(other.d_allocator) {
+    steal(other);
+  }
+
+  small_vector(small_vector &&other, allocator_type allocator)
+      : d_allocator(allocator) {
+    if (d_allocator == other.d_allocator)
+      steal(other);
+    else {
+      reserve(other.size());
+      for (T &value : other)
+        emplace_back(std::move(value));
+    }
+  }
+
+  ~small_vector() {
+    clear();
+    deallocate();
+  }
+
+  small_vector &operator=(const small_vector &other) {
+    if (this != &other)
+      assign(other.begin(), other.end());
+    return *this;
+  }
+
+  // As for 'std::pmr::vector', the allocator isn't propagated, so this can
+  // only steal 'other's heap storage when the allocators compare equal.
+  small_vector &operator=(small_vector &&other) {
+    if (this == &other)
+      return *this;
+    if (d_allocator == other.d_allocator && !other.is_inline()) {
+      clear();
+      deallocate();
+      steal(other);
+    } else {
+      clear();
+      reserve(other.size());
+      for (T &value : other)
+        emplace_back(std::move(value));
+      other.clear();
+    }
+    return *this;
+  }
+
+  allocator_type get_allocator() const noexcept { return d_allocator; }
+
+  iterator begin() noexcept { return d_data; }
+  const_iterator begin() const noexcept { return d_data; }
+  iterator end() noexcept { return d_data + d_size; }
+  const_iterator end() const noexcept { return d_data + d_size; }
+
+  T *data() noexcept { return d_data; }
+  const T *data() const noexcept { return d_data; }
+
+  size_type size() const noexcept { return d_size; }
+  size_type capacity() const noexcept { return d_capacity; }
+  bool empty() const noexcept { return d_size == 0; }
+
+  // Return true if the elements are stored inline.
+  bool is_inline() const noexcept { return d_data == inline_data(); }
+
+  T &operator[](size_type i) { return d_data[i]; }
+  const T &operator[](size_type i) const { return d_data[i]; }
+
+  T &at(size_type i) {
+    if (i >= d_size)
+      throw std::out_of_range("small_vector::at");
+    return d_data[i];
+  }
+  const T &at(size_type i) const {
+    if (i >= d_size)
+      throw std::out_of_range("small_vector::at");
+    return d_data[i];
+  }
+
+  T &front() { return d_data[0]; }
+  const T &front() const { return d_data[0]; }
+  T &back() { return d_data[d_size - 1]; }
+  const T &back() const { return d_data[d_size - 1]; }
+
+  void reserve(size_type capacity) {
+    if (capacity > d_capacity)
+      reallocate(capacity);
+  }
+
+  template <typename... Args> T &emplace_back(Args &&...args) {
+    if (d_size == d_capacity) {
+      // Construct the new element before relocating the old ones, in case
+      // 'args' refers to one of them.
+      small_vector grown(d_allocator);
+      grown.reserve(std::max<size_type>(2 * d_capacity, 1));
+      construct(grown.d_data + d_size, std::forward<Args>(args)...);
+      try {
+        relocate_to(grown.d_data);
+      } catch (...) {
+        std::destroy_at(grown.d_data + d_size);
+        throw;
+      }
+      grown.d_size = d_size + 1;
+      destroy_all();
+      deallocate();
+      steal(grown);
+      return back();
+    }
+    construct(d_data + d_size, std::forward<Args>(args)...);
+    ++d_size;
+    return back();
+  }
+
+  void push_back(const T &value) { emplace_back(value); }
+  void push_back(T &&value) { emplace_back(std::move(value)); }
+
+  void pop_back() { std::destroy_at(d_data + --d_size); }
+
+  void resize(size_type count) {
+    if (count < d_size) {
+      std::destroy(d_data + count, d_data + d_size);
+      d_size = count;
+      return;
+    }
+    reserve(count);
+    while (d_size != count)
+      emplace_back();
+  }
+
+  void assign(size_type count, const T &value) {
+    clear();
+    reserve(count);
+    while (d_size != count)
+      emplace_back(value);
+  }
+
+  template <typename InputIt> void assign(InputIt first, InputIt last) {
+    clear();
+    if constexpr (std::is_base_of_v<std::forward_iterator_tag,
+                                    typename std::iterator_traits<
+                                        InputIt>::iterator_category>)
+      reserve(std::distance(first, last));
+    for (; first != last; ++first)
+      emplace_back(*first);
+  }
+
+  void clear() noexcept { destroy_all(); }
+
+  friend bool operator==(const small_vector &lhs, const small_vector &rhs) {
+    return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+  }
+  friend bool operator!=(const small_vector &lhs, const small_vector &rhs) {
+    return !(lhs == rhs);
+  }
+
+private:
+  allocator_type d_allocator;
+  T *d_data = inline_data();
+  size_type d_size = 0;
+  size_type d_capacity = N;
+  alignas(T) unsigned char d_inline[N == 0 ? 1 : N * sizeof(T)];
+
+  T *inline_data() noexcept { return reinterpret_cast<T *>(d_inline); }
+  const T *inline_data() const noexcept {
+    return reinterpret_cast<const T *>(d_inline);
+  }
+
+  // Construct with uses-allocator construction so that allocator-aware
+  // elements share this vector's resource.
+  template <typename... Args> void construct(T *p, Args &&...args) {
+    d_allocator.construct(p, std::forward<Args>(args)...);
+  }
+
+  void destroy_all() noexcept {
+    std::destroy(d_data, d_data + d_size);
+    d_size = 0;
+  }
+
+  void deallocate() noexcept {
+    if (!is_inline())
+      d_allocator.deallocate(d_data, d_capacity);
+    d_data = inline_data();
+    d_capacity = N;
+  }
+
+  // Move or copy this vector's elements to uninitialized 'destination',
+  // destroying what was constructed there if an exception is thrown.
+  void relocate_to(T *destination) {
+    size_type constructed = 0;
+    try {
+      for (; constructed != d_size; ++constructed)
+        construct(destination + constructed,
+                  std::move_if_noexcept(d_data[constructed]));
+    } catch (...) {
+      std::destroy(destination, destination + constructed);
+      throw;
+    }
+  }
+
+  void reallocate(size_type capacity) {
+    T *const storage = d_allocator.allocate(capacity);
+    try {
+      relocate_to(storage);
+    } catch (...) {
+      d_allocator.deallocate(storage, capacity);
+      throw;
+    }
+    const size_type size = d_size;
+    destroy_all();
+    deallocate();
+    d_data = storage;
+    d_size = size;
+    d_capacity = capacity;
+  }
+
+  // Take 'other's elements, which must use an equal allocator, leaving it
+  // empty. If moving an inline element throws, 'other' is left unchanged.
+  void steal(small_vector &other) {
+    if (other.is_inline()) {
+      size_type moved = 0;
+      try {
+        for (; moved != other.d_size; ++moved)
+          ::new (static_cast<void *>(d_data + moved))
+              T(std::move_if_noexcept(other.d_data[moved]));
+      } catch (...) {
+        std::destroy(d_data, d_data + moved);
+        throw;
+      }
+      d_size = other.d_size;
+      other.destroy_all();
+      return;
+    }
+    d_data = other.d_data;
+    d_size = other.d_size;
+    d_capacity = other.d_capacity;
+    other.d_data = other.inline_data();
+    other.d_size = 0;
+    other.d_capacity = N;
+  }
+};
+
+} // namespace pmr
+
+#endif
@@ -0,0 +1,174 @@
+#ifndef STRING_INTERNER_HPP_
+#define STRING_INTERNER_HPP_
+
+// A set of unique strings and the handles that refer to them. Interning the
+// same bytes twice yields the same 'interned_string', an 8-byte handle that
+// compares and hashes in constant time and converts to 'std::string_view'
+// without copying. The bytes live in monotonic arenas for the lifetime of
+// the 'string_interner'.
+//
+// A class that would otherwise hold a 'std::pmr::string' key, like 'Bar9',
+// can hold an 'interned_string' instead. The handle allocates nothing, so it
+// needs no allocator and is trivially copyable.
+
+#include <memory_resource.hpp>
+#include <vector.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <string_view>
+#include <utility>
+
+class string_interner;
+
+class interned_string {
+public:
+  // Create a handle to the empty string.
+  interned_string() = default;
+
+  std::string_view view() const {
+    return d_entry ? std::string_view(d_entry->data(), d_entry->d_size)
+                   : std::string_view();
+  }
+
+  operator std::string_view() const { return view(); }
+
+  // Return the bytes followed by a null terminator.
+  const char *c_str() const { return d_entry ? d_entry->data() : ""; }
+
+  std::size_t size() const { return d_entry ? d_entry->d_size : 0; }
+  bool empty() const { return !d_entry; }
+
+  std::size_t hash() const {
+    return d_entry ? d_entry->d_hash : std::hash<std::string_view>{}({});
+  }
+
+  // Handles from the same interner are equal exactly when their strings
+  // are.
+  friend bool operator==(interned_string lhs, interned_string rhs) {
+    return lhs.d_entry == rhs.d_entry;
+  }
+  friend bool operator!=(interned_string lhs, interned_string rhs) {
+    return lhs.d_entry != rhs.d_entry;
+  }
+
+private:
+  friend class string_interner;
+
+  // The header of a string in the arena; the bytes and a terminating null
+  // follow it.
+  struct entry {
+    std::size_t d_hash;
+    std::size_t d_size;
+
+    const char *data() const {
+      return reinterpret_cast<const char *>(this + 1);
+    }
+  };
+
+  const entry *d_entry = nullptr;
+
+  explicit interned_string(const entry *e) : d_entry(e) {}
+};
+
+namespace std {
+template <> struct hash<interned_string> {
+  std::size_t operator()(interned_string s) const { return s.hash(); }
+};
+} // namespace std
+
+// Thread-safe. Strings are spread over independently locked shards by hash,
+// so threads interning different strings rarely contend.
+class string_interner {
+public:
+  explicit string_interner(std::pmr::memory_resource *upstream =
+                               std::pmr::get_default_resource())
+      : d_shards(make_shards(upstream, std::make_index_sequence<k_shards>{})) {}
+
+  string_interner(const string_interner &) = delete;
+  string_interner &operator=(const string_interner &) = delete;
+
+  // Return the handle of the string equal to 's', adding it if needed.
+  interned_string intern(std::string_view s) {
+    if (s.empty())
+      return interned_string();
+    const std::size_t hash = std::hash<std::string_view>{}(s);
+    shard &sh = d_shards[(hash >> 32 ^ hash) % k_shards];
+    std::lock_guard<std::mutex> lock(sh.d_mutex);
+
+    if ((sh.d_count + 1) * 4 > sh.d_table.size() * 3)
+      grow(sh);
+    const std::size_t mask = sh.d_table.size() - 1;
+    std::size_t slot = hash & mask;
+    for (; sh.d_table[slot]; slot = (slot + 1) & mask) {
+      const entry *e = sh.d_table[slot];
+      if (e->d_hash == hash && e->d_size == s.size() &&
+          std::memcmp(e->data(), s.data(), s.size()) == 0)
+        return interned_string(e);
+    }
+
+    void *const memory = sh.d_arena.allocate(sizeof(entry) + s.size() + 1,
+                                             alignof(entry));
+    entry *const e = ::new (memory) entry{hash, s.size()};
+    char *const bytes = const_cast<char *>(e->data());
+    std::memcpy(bytes, s.data(), s.size());
+    bytes[s.size()] = '\0';
+    sh.d_table[slot] = e;
+    ++sh.d_count;
+    return interned_string(e);
+  }
+
+  // Return the number of distinct non-empty strings interned.
+  std::size_t size() const {
+    std::size_t result = 0;
+    for (const shard &sh : d_shards) {
+      std::lock_guard<std::mutex> lock(sh.d_mutex);
+      result += sh.d_count;
+    }
+    return result;
+  }
+
+private:
+  using entry = interned_string::entry;
+
+  static constexpr std::size_t k_shards = 16;
+
+  struct shard {
+    explicit shard(std::pmr::memory_resource *upstream)
+        : d_arena(upstream), d_table(16, nullptr, upstream) {}
+
+    mutable std::mutex d_mutex;
+    std::pmr::monotonic_buffer_resource d_arena;
+    std::pmr::vector<const entry *> d_table; // open addressing, power of 2
+    std::size_t d_count = 0;
+  };
+
+  std::array<shard, k_shards> d_shards;
+
+  template <std::size_t... I>
+  static std::array<shard, k_shards>
+  make_shards(std::pmr::memory_resource *upstream, std::index_sequence<I...>) {
+    return {{(static_cast<void>(I), shard(upstream))...}};
+  }
+
+  static void grow(shard &sh) {
+    std::pmr::vector<const entry *> table(sh.d_table.size() * 2, nullptr,
+                                          sh.d_table.get_allocator());
+    const std::size_t mask = table.size() - 1;
+    for (const entry *e : sh.d_table) {
+      if (!e)
+        continue;
+      std::size_t slot = e->d_hash & mask;
+      while (table[slot])
+        slot = (slot + 1) & mask;
+      table[slot] = e;
+    }
+    sh.d_table.swap(table);
+  }
+};
+
+#endif